@@ -0,0 +1,209 @@
+// This file is part of ristretto-donna.
+// Copyright (c) 2019 isis lovecruft
+// See LICENSE for licensing information.
+//
+// Authors:
+// - isis agora lovecruft <isis@patternsinthevoid.net>
+
+#define RISTRETTO_DONNA_PRIVATE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ed25519.h"
+#include "ristretto-donna.h"
+#include "test-ticks.h"
+
+#define BENCH_ROUNDS 5
+
+/// Fill `bytes` with deterministic pseudorandom junk derived from `seed`
+static void fill_pseudorandom_bytes(unsigned char *bytes, size_t len, uint32_t seed)
+{
+  size_t i;
+
+  for (i=0; i<len; i++) {
+    seed = seed * 1103515245 + 12345;
+    bytes[i] = (unsigned char)(seed >> 16);
+  }
+}
+
+/// Fill `points` and `scalars` with `n` pseudorandom entries
+static void generate_terms(ristretto_point_t *points, bignum256modm *scalars, size_t n)
+{
+  unsigned char bytes[32];
+  size_t i;
+
+  for (i=0; i<n; i++) {
+    fill_pseudorandom_bytes(bytes, 32, (uint32_t)(i + 1));
+    ristretto_scalarmult_base(&points[i], bytes);
+    fill_pseudorandom_bytes(bytes, 32, (uint32_t)(i + 1000000));
+    expand256_modm(scalars[i], bytes, 32);
+  }
+}
+
+/**
+ * Time Straus against Pippenger for increasing batch sizes, to find where
+ * `multiscalar_pippenger_threshold` should sit.
+ */
+static void bench_multiscalar_mul(void)
+{
+  const size_t sizes[] = {4, 16, 64, 128, 192, 256, 512, 1024, 4096, 16384};
+  const size_t max_size = 16384;
+  ristretto_point_t *points;
+  bignum256modm *scalars;
+  ristretto_point_t a, b;
+  uint64_t ticks, straus_ticks, pippenger_ticks;
+  size_t i, j, n;
+
+  points = (ristretto_point_t*)malloc(max_size * sizeof(ristretto_point_t));
+  scalars = (bignum256modm*)malloc(max_size * sizeof(bignum256modm));
+  generate_terms(points, scalars, max_size);
+
+  printf("multiscalar multiplication (ticks/term):\n");
+  printf("%8s %12s %12s\n", "n", "straus", "pippenger");
+
+  for (i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+    n = sizes[i];
+    straus_ticks = maxticks;
+    pippenger_ticks = maxticks;
+
+    for (j=0; j<BENCH_ROUNDS; j++) {
+      timeit(ristretto_multiscalar_mul_straus_vartime(&a, points, scalars, n), straus_ticks)
+      timeit(ristretto_multiscalar_mul_pippenger_vartime(&b, points, scalars, n), pippenger_ticks)
+    }
+
+    printf("%8zu %12.0f %12.0f%s\n", n,
+           (double)straus_ticks / n, (double)pippenger_ticks / n,
+           ristretto_ct_eq(&a, &b) ? "" : "  MISMATCH");
+  }
+
+  free(points);
+  free(scalars);
+}
+
+/**
+ * Time the codec and the field inverse square root under it, one point at a
+ * time and batched.  Run the benchmark built against each backend (the
+ * default, with `-DED25519_SSE2=ON` and with `-DED25519_FORCE_32BIT`) to
+ * compare them.
+ */
+static void bench_codec(void)
+{
+  const size_t n = 256;
+  unsigned char (*encoded)[32];
+  ristretto_point_t *points;
+  int *valid;
+  bignum25519 ALIGN(16) u, v, r;
+  unsigned char bytes[32];
+  uint64_t ticks, decode_ticks = maxticks, encode_ticks = maxticks;
+  uint64_t decode_batch_ticks = maxticks, encode_batch_ticks = maxticks;
+  uint64_t eq_ticks = maxticks, sqrt_ticks = maxticks;
+  size_t i, j;
+  int ok = 1;
+
+  encoded = (unsigned char (*)[32])malloc(n * 32);
+  points = (ristretto_point_t*)malloc(n * sizeof(ristretto_point_t));
+  valid = (int*)malloc(n * sizeof(int));
+  for (i=0; i<n; i++) {
+    fill_pseudorandom_bytes(bytes, 32, (uint32_t)(i + 1));
+    ristretto_scalarmult_base(&points[i], bytes);
+    ristretto_encode(encoded[i], &points[i]);
+  }
+  fill_pseudorandom_bytes(bytes, 32, 1);
+  curve25519_expand(u, bytes);
+  fill_pseudorandom_bytes(bytes, 32, 2);
+  curve25519_expand(v, bytes);
+
+  for (j=0; j<BENCH_ROUNDS; j++) {
+    timeit(for (i=0; i<n; i++) ok &= ristretto_decode(&points[i], encoded[i]), decode_ticks)
+    timeit(ok &= ristretto_decode_batch(points, (const unsigned char (*)[32])encoded, n, valid), decode_batch_ticks)
+    timeit(for (i=0; i<n; i++) ristretto_encode(encoded[i], &points[i]), encode_ticks)
+    timeit(ristretto_encode_batch(encoded, points, n), encode_batch_ticks)
+    timeit(for (i=1; i<n; i++) ok &= 1 - ristretto_ct_eq(&points[i - 1], &points[i]), eq_ticks)
+    timeit(for (i=0; i<n; i++) curve25519_sqrt_ratio_i(r, u, v), sqrt_ticks)
+  }
+
+  printf("codec, %s backend, n=%zu (ticks/element):\n", ed25519_backend(), n);
+  printf("%12s %12s %12s %12s %12s %12s\n",
+         "decode", "batch", "encode", "batch", "ct_eq", "sqrt_ratio");
+  printf("%12.0f %12.0f %12.0f %12.0f %12.0f %12.0f%s\n",
+         (double)decode_ticks / n, (double)decode_batch_ticks / n,
+         (double)encode_ticks / n, (double)encode_batch_ticks / n,
+         (double)eq_ticks / (n - 1), (double)sqrt_ticks / n,
+         ok ? "" : "  MISMATCH");
+
+  free(encoded);
+  free(points);
+  free(valid);
+}
+
+/**
+ * Time `ristretto_from_uniform_bytes_batch()` against the same number of
+ * sequential `ristretto_from_uniform_bytes()` calls.
+ */
+static void bench_from_uniform_bytes(void)
+{
+  const size_t n = 256;
+  unsigned char (*inputs)[64];
+  ristretto_point_t *out;
+  uint64_t ticks, sequential_ticks = maxticks, batch_ticks = maxticks;
+  size_t i, j;
+
+  inputs = (unsigned char (*)[64])malloc(n * 64);
+  out = (ristretto_point_t*)malloc(n * sizeof(ristretto_point_t));
+  fill_pseudorandom_bytes((unsigned char*)inputs, n * 64, 1);
+
+  for (j=0; j<BENCH_ROUNDS; j++) {
+    timeit(for (i=0; i<n; i++) ristretto_from_uniform_bytes(&out[i], inputs[i]), sequential_ticks)
+    timeit(ristretto_from_uniform_bytes_batch(out, (const unsigned char (*)[64])inputs, n), batch_ticks)
+  }
+
+  printf("from uniform bytes, n=%zu (ticks/element):\n", n);
+  printf("%12s %12s\n", "sequential", "batch");
+  printf("%12.0f %12.0f\n", (double)sequential_ticks / n, (double)batch_ticks / n);
+
+  free(inputs);
+  free(out);
+}
+
+/**
+ * Time `ristretto_scalar_batch_invert()` against the same number of
+ * sequential `ristretto_scalar_invert()` calls.
+ */
+static void bench_scalar_batch_invert(void)
+{
+  const size_t n = 256;
+  ristretto_scalar_t *scalars, *scratch;
+  unsigned char bytes[32];
+  uint64_t ticks, sequential_ticks = maxticks, batch_ticks = maxticks;
+  size_t i, j;
+
+  scalars = (ristretto_scalar_t*)malloc(n * sizeof(ristretto_scalar_t));
+  scratch = (ristretto_scalar_t*)malloc(n * sizeof(ristretto_scalar_t));
+  for (i=0; i<n; i++) {
+    fill_pseudorandom_bytes(bytes, 32, (uint32_t)(i + 1));
+    ristretto_scalar_from_bytes_mod_order(&scalars[i], bytes);
+  }
+
+  for (j=0; j<BENCH_ROUNDS; j++) {
+    timeit(for (i=0; i<n; i++) ristretto_scalar_invert(&scalars[i], &scalars[i]), sequential_ticks)
+    timeit(ristretto_scalar_batch_invert(scalars, n, scratch), batch_ticks)
+  }
+
+  printf("scalar inversion, n=%zu (ticks/element):\n", n);
+  printf("%12s %12s\n", "sequential", "batch");
+  printf("%12.0f %12.0f\n", (double)sequential_ticks / n, (double)batch_ticks / n);
+
+  free(scalars);
+  free(scratch);
+}
+
+int main(int argc, char **argv)
+{
+  bench_codec();
+  bench_multiscalar_mul();
+  bench_from_uniform_bytes();
+  bench_scalar_batch_invert();
+
+  return 0;
+}
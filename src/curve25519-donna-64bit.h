@@ -102,6 +102,30 @@ curve25519_neg(bignum25519 out, const bignum25519 a) {
 	out[0] += c * 19;
 }
 
+/*
+	reduce the 128 bit column sums t[0..4] of a product to r0..r4
+
+	all five columns are carried at once and then once more in 64 bits, instead
+	of one after the other through t[1]..t[4], which keeps the carries off the
+	critical path of long multiplication chains. every limb of the result may be
+	slightly over 51 bits (below 2^51 + 2^18), as r1 already was
+*/
+#define curve25519_reduce_columns(r0, r1, r2, r3, r4, t) { \
+	uint64_t c0_, c1_, c2_, c3_, c4_; \
+	r0 = lo128(t[0]) & reduce_mask_51; shr128(c0_, t[0], 51); \
+	r1 = lo128(t[1]) & reduce_mask_51; shr128(c1_, t[1], 51); \
+	r2 = lo128(t[2]) & reduce_mask_51; shr128(c2_, t[2], 51); \
+	r3 = lo128(t[3]) & reduce_mask_51; shr128(c3_, t[3], 51); \
+	r4 = lo128(t[4]) & reduce_mask_51; shr128(c4_, t[4], 51); \
+	r0 += c4_ * 19; r1 += c0_; r2 += c1_; r3 += c2_; r4 += c3_; \
+	c0_ = r0 >> 51; c1_ = r1 >> 51; c2_ = r2 >> 51; c3_ = r3 >> 51; c4_ = r4 >> 51; \
+	r0 = (r0 & reduce_mask_51) + c4_ * 19; \
+	r1 = (r1 & reduce_mask_51) + c0_; \
+	r2 = (r2 & reduce_mask_51) + c1_; \
+	r3 = (r3 & reduce_mask_51) + c2_; \
+	r4 = (r4 & reduce_mask_51) + c3_; \
+}
+
 /* out = a * b */
 DONNA_INLINE static void
 curve25519_mul(bignum25519 out, const bignum25519 in2, const bignum25519 in) {
@@ -109,7 +133,7 @@ curve25519_mul(bignum25519 out, const bignum25519 in2, const bignum25519 in) {
 	uint128_t mul;
 #endif
 	uint128_t t[5];
-	uint64_t r0,r1,r2,r3,r4,s0,s1,s2,s3,s4,c;
+	uint64_t r0,r1,r2,r3,r4,s0,s1,s2,s3,s4;
 
 	r0 = in[0];
 	r1 = in[1];
@@ -154,14 +178,7 @@ curve25519_mul(bignum25519 out, const bignum25519 in2, const bignum25519 in) {
 	mul64x64_128(mul, r4, s4) add128(t[3], mul)
 #endif
 
-
-	                     r0 = lo128(t[0]) & reduce_mask_51; shr128(c, t[0], 51);
-	add128_64(t[1], c)   r1 = lo128(t[1]) & reduce_mask_51; shr128(c, t[1], 51);
-	add128_64(t[2], c)   r2 = lo128(t[2]) & reduce_mask_51; shr128(c, t[2], 51);
-	add128_64(t[3], c)   r3 = lo128(t[3]) & reduce_mask_51; shr128(c, t[3], 51);
-	add128_64(t[4], c)   r4 = lo128(t[4]) & reduce_mask_51; shr128(c, t[4], 51);
-	r0 +=   c * 19; c = r0 >> 51; r0 = r0 & reduce_mask_51;
-	r1 +=   c;
+	curve25519_reduce_columns(r0, r1, r2, r3, r4, t)
 
 	out[0] = r0;
 	out[1] = r1;
@@ -182,7 +199,7 @@ curve25519_square_times(bignum25519 out, const bignum25519 in, uint64_t count) {
 	uint128_t mul;
 #endif
 	uint128_t t[5];
-	uint64_t r0,r1,r2,r3,r4,c;
+	uint64_t r0,r1,r2,r3,r4;
 	uint64_t d0,d1,d2,d4,d419;
 
 	r0 = in[0];
@@ -212,18 +229,7 @@ curve25519_square_times(bignum25519 out, const bignum25519 in, uint64_t count) {
 		mul64x64_128(t[4], d0, r4) mul64x64_128(mul, d1, r3) add128(t[4], mul) mul64x64_128(mul, r2,      r2) add128(t[4], mul)
 #endif
 
-		r0 = lo128(t[0]) & reduce_mask_51;
-		r1 = lo128(t[1]) & reduce_mask_51; shl128(c, t[0], 13); r1 += c;
-		r2 = lo128(t[2]) & reduce_mask_51; shl128(c, t[1], 13); r2 += c;
-		r3 = lo128(t[3]) & reduce_mask_51; shl128(c, t[2], 13); r3 += c;
-		r4 = lo128(t[4]) & reduce_mask_51; shl128(c, t[3], 13); r4 += c; 
-		                                   shl128(c, t[4], 13); r0 += c * 19;
-		               c = r0 >> 51; r0 &= reduce_mask_51;
-		r1 += c     ;  c = r1 >> 51; r1 &= reduce_mask_51;
-		r2 += c     ;  c = r2 >> 51; r2 &= reduce_mask_51;
-		r3 += c     ;  c = r3 >> 51; r3 &= reduce_mask_51;
-		r4 += c     ;  c = r4 >> 51; r4 &= reduce_mask_51;
-		r0 += c * 19;
+		curve25519_reduce_columns(r0, r1, r2, r3, r4, t)
 	} while(--count);
 
 	out[0] = r0;
@@ -239,7 +245,7 @@ curve25519_square(bignum25519 out, const bignum25519 in) {
 	uint128_t mul;
 #endif
 	uint128_t t[5];
-	uint64_t r0,r1,r2,r3,r4,c;
+	uint64_t r0,r1,r2,r3,r4;
 	uint64_t d0,d1,d2,d4,d419;
 
 	r0 = in[0];
@@ -268,13 +274,7 @@ curve25519_square(bignum25519 out, const bignum25519 in) {
 	mul64x64_128(t[4], d0, r4) mul64x64_128(mul, d1, r3) add128(t[4], mul) mul64x64_128(mul, r2,      r2) add128(t[4], mul)
 #endif
 
-	                     r0 = lo128(t[0]) & reduce_mask_51; shr128(c, t[0], 51);
-	add128_64(t[1], c)   r1 = lo128(t[1]) & reduce_mask_51; shr128(c, t[1], 51);
-	add128_64(t[2], c)   r2 = lo128(t[2]) & reduce_mask_51; shr128(c, t[2], 51);
-	add128_64(t[3], c)   r3 = lo128(t[3]) & reduce_mask_51; shr128(c, t[3], 51);
-	add128_64(t[4], c)   r4 = lo128(t[4]) & reduce_mask_51; shr128(c, t[4], 51);
-	r0 +=   c * 19; c = r0 >> 51; r0 = r0 & reduce_mask_51;
-	r1 +=   c;
+	curve25519_reduce_columns(r0, r1, r2, r3, r4, t)
 
 	out[0] = r0;
 	out[1] = r1;
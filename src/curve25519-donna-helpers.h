@@ -65,3 +65,62 @@ curve25519_pow_two252m3(bignum25519 two252m3, const bignum25519 z) {
 	/* 2^252 - 2^2 */ curve25519_square_times(b, b, 2);
 	/* 2^252 - 3 */ curve25519_mul_noinline(two252m3, b, z);
 }
+
+/*
+ * out = in, or one if in is zero. returns 1 if in was zero
+ */
+static uint32_t
+curve25519_copy_nonzero(bignum25519 out, const bignum25519 in) {
+	bignum25519 ALIGN(16) t = {1};
+	unsigned char check[32], bits = 0;
+	uint32_t is_zero;
+	size_t i;
+
+	curve25519_copy(out, in);
+	curve25519_contract(check, in);
+	for (i = 0; i < 32; i++)
+		bits |= check[i];
+	is_zero = (uint32_t)(((unsigned int)bits - 1) >> 8) & 1;
+	curve25519_swap_conditional(out, t, is_zero);
+	return is_zero;
+}
+
+/*
+ * out[i] = in[i]^(p - 2) for i < n with one curve25519_recip and 3(n - 1)
+ * multiplications (Montgomery's trick). Zero inputs give zero outputs, as with
+ * curve25519_recip, without poisoning the rest of the batch. out and in must
+ * not overlap
+ */
+static void
+curve25519_batch_recip(bignum25519 *out, const bignum25519 *in, size_t n) {
+	bignum25519 ALIGN(16) acc, nz, t, zero;
+	uint32_t is_zero;
+	size_t i;
+
+	if (!n)
+		return;
+
+	/* out[i] = in[0] * .. * in[i] */
+	curve25519_copy_nonzero(out[0], in[0]);
+	for (i = 1; i < n; i++) {
+		curve25519_copy_nonzero(nz, in[i]);
+		curve25519_mul(out[i], out[i - 1], nz);
+	}
+
+	curve25519_recip(acc, out[n - 1]);
+
+	/* acc = 1 / (in[0] * .. * in[i]) going in to each step */
+	for (i = n - 1; i > 0; i--) {
+		is_zero = curve25519_copy_nonzero(nz, in[i]);
+		curve25519_mul(t, acc, out[i - 1]);
+		curve25519_mul(acc, acc, nz);
+		memset(zero, 0, sizeof(bignum25519));
+		curve25519_swap_conditional(t, zero, is_zero);
+		curve25519_copy(out[i], t);
+	}
+
+	is_zero = curve25519_copy_nonzero(nz, in[0]);
+	memset(zero, 0, sizeof(bignum25519));
+	curve25519_swap_conditional(acc, zero, is_zero);
+	curve25519_copy(out[0], acc);
+}
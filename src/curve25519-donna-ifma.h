@@ -0,0 +1,346 @@
+/*
+	AVX-512 IFMA curve25519 field arithmetic, four field elements at a time
+
+	The curve25519x4 interface used by ed25519-donna-impl-x4.h. Elements
+	use the 5 limb, radix 2^51 representation of curve25519-donna-64bit.h,
+	and limb i of all four elements shares one ymm register with one
+	element per 64 bit lane. vpmadd52luq/vpmadd52huq multiply the low 52
+	bits of each lane, which leaves just enough headroom over a carried
+	limb for 2p - x.
+
+	The functions are compiled for IFMA through target attributes rather
+	than -m flags, so the rest of the library still runs on hosts without
+	it. Callers check curve25519x4_available() first and fall back to the
+	64 bit code otherwise.
+*/
+
+#include <immintrin.h>
+typedef __m256i ymmi;
+
+#define CURVE25519X4_FN __attribute__((target("avx2,avx512f,avx512vl,avx512ifma")))
+#define ED25519_X4_BACKEND "avx512ifma"
+
+typedef union packedelem32x8_t {
+	uint32_t u[8];
+	ymmi v;
+} packedelem32x8;
+
+typedef union packedelem64x4_t {
+	uint64_t u[4];
+	ymmi v;
+} packedelem64x4;
+
+typedef ymmi bignum25519x4[5];
+
+/* is IFMA usable on this host? */
+static int
+curve25519x4_available(void) {
+	static int available = -1;
+	if (available < 0) {
+		__builtin_cpu_init();
+		available = (__builtin_cpu_supports("avx512ifma") && __builtin_cpu_supports("avx512vl")) ? 1 : 0;
+	}
+	return available;
+}
+
+/* reduction mask */
+static const packedelem64x4 ALIGN(32) packed4mask51 = {{0x7ffffffffffff, 0x7ffffffffffff, 0x7ffffffffffff, 0x7ffffffffffff}};
+
+/* 2*(2^255 - 19) = 0 mod p, limb 0 and the remaining limbs */
+static const packedelem64x4 ALIGN(32) packed4x2p0 = {{0xfffffffffffda, 0xfffffffffffda, 0xfffffffffffda, 0xfffffffffffda}};
+static const packedelem64x4 ALIGN(32) packed4x2p1 = {{0xffffffffffffe, 0xffffffffffffe, 0xffffffffffffe, 0xffffffffffffe}};
+
+/* 4*(2^255 - 19) = 0 mod p */
+static const packedelem64x4 ALIGN(32) packed4x4p0 = {{0x1fffffffffffb4, 0x1fffffffffffb4, 0x1fffffffffffb4, 0x1fffffffffffb4}};
+static const packedelem64x4 ALIGN(32) packed4x4p1 = {{0x1ffffffffffffc, 0x1ffffffffffffc, 0x1ffffffffffffc, 0x1ffffffffffffc}};
+
+/*
+	lane permutations for curve25519x4_permute, lanes are named A,B,C,D and
+	e.g. BADC moves lane B to lane A, lane A to lane B, and so on
+*/
+#define packed4permute(a, b, c, d) {{(a)*2, (a)*2+1, (b)*2, (b)*2+1, (c)*2, (c)*2+1, (d)*2, (d)*2+1}}
+static const packedelem32x8 ALIGN(32) packed4_AAAA = packed4permute(0, 0, 0, 0);
+static const packedelem32x8 ALIGN(32) packed4_BBBB = packed4permute(1, 1, 1, 1);
+static const packedelem32x8 ALIGN(32) packed4_BADC = packed4permute(1, 0, 3, 2);
+static const packedelem32x8 ALIGN(32) packed4_ABDC = packed4permute(0, 1, 3, 2);
+static const packedelem32x8 ALIGN(32) packed4_ADDA = packed4permute(0, 3, 3, 0);
+static const packedelem32x8 ALIGN(32) packed4_CBCB = packed4permute(2, 1, 2, 1);
+static const packedelem32x8 ALIGN(32) packed4_CACA = packed4permute(2, 0, 2, 0);
+static const packedelem32x8 ALIGN(32) packed4_DBBD = packed4permute(3, 1, 1, 3);
+static const packedelem32x8 ALIGN(32) packed4_ABCA = packed4permute(0, 1, 2, 0);
+static const packedelem32x8 ALIGN(32) packed4_BACD = packed4permute(1, 0, 2, 3);
+#undef packed4permute
+
+/* out = in */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_copy(bignum25519x4 out, const bignum25519x4 in) {
+	int i;
+	for (i = 0; i < 5; i++)
+		out[i] = in[i];
+}
+
+/* out = 0 */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_zero(bignum25519x4 out) {
+	int i;
+	for (i = 0; i < 5; i++)
+		out[i] = _mm256_setzero_si256();
+}
+
+/*
+	carry every limb in parallel, limbs may be up to 2^63 on entry. a single
+	round leaves each limb below 2^51 + 2^17, which is all the 52 bit
+	multiplier needs, and keeps the carry off the critical path
+*/
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_carry(bignum25519x4 out) {
+	const ymmi mask51 = packed4mask51.v;
+	ymmi c0, c1, c2, c3, c4;
+
+	c0 = _mm256_srli_epi64(out[0], 51);
+	c1 = _mm256_srli_epi64(out[1], 51);
+	c2 = _mm256_srli_epi64(out[2], 51);
+	c3 = _mm256_srli_epi64(out[3], 51);
+	c4 = _mm256_srli_epi64(out[4], 51);
+	/* c4 * 19 */
+	c4 = _mm256_add_epi64(c4, _mm256_add_epi64(_mm256_slli_epi64(c4, 1), _mm256_slli_epi64(c4, 4)));
+	out[0] = _mm256_add_epi64(_mm256_and_si256(out[0], mask51), c4);
+	out[1] = _mm256_add_epi64(_mm256_and_si256(out[1], mask51), c0);
+	out[2] = _mm256_add_epi64(_mm256_and_si256(out[2], mask51), c1);
+	out[3] = _mm256_add_epi64(_mm256_and_si256(out[3], mask51), c2);
+	out[4] = _mm256_add_epi64(_mm256_and_si256(out[4], mask51), c3);
+}
+
+/* out = a + b, without carrying */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_add(bignum25519x4 out, const bignum25519x4 a, const bignum25519x4 b) {
+	int i;
+	for (i = 0; i < 5; i++)
+		out[i] = _mm256_add_epi64(a[i], b[i]);
+}
+
+/* out = a + b, carried */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_add_reduce(bignum25519x4 out, const bignum25519x4 a, const bignum25519x4 b) {
+	curve25519x4_add(out, a, b);
+	curve25519x4_carry(out);
+}
+
+/* out = a + 2p - b, without carrying. b must be carried */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_sub(bignum25519x4 out, const bignum25519x4 a, const bignum25519x4 b) {
+	int i;
+	out[0] = _mm256_sub_epi64(_mm256_add_epi64(a[0], packed4x2p0.v), b[0]);
+	for (i = 1; i < 5; i++)
+		out[i] = _mm256_sub_epi64(_mm256_add_epi64(a[i], packed4x2p1.v), b[i]);
+}
+
+/* out = a + 4p - b, without carrying. b may be the sum of two carried values */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_sub_after_basic(bignum25519x4 out, const bignum25519x4 a, const bignum25519x4 b) {
+	int i;
+	out[0] = _mm256_sub_epi64(_mm256_add_epi64(a[0], packed4x4p0.v), b[0]);
+	for (i = 1; i < 5; i++)
+		out[i] = _mm256_sub_epi64(_mm256_add_epi64(a[i], packed4x4p1.v), b[i]);
+}
+
+/* out = 2p - a, without carrying. a must be carried, and the result is below 2^52 */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_neg(bignum25519x4 out, const bignum25519x4 a) {
+	int i;
+	out[0] = _mm256_sub_epi64(packed4x2p0.v, a[0]);
+	for (i = 1; i < 5; i++)
+		out[i] = _mm256_sub_epi64(packed4x2p1.v, a[i]);
+}
+
+/* lane k of out = lane sel[k] of in */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_permute(bignum25519x4 out, const bignum25519x4 in, const packedelem32x8 *sel) {
+	const ymmi s = sel->v;
+	int i;
+	for (i = 0; i < 5; i++)
+		out[i] = _mm256_permutevar8x32_epi32(in[i], s);
+}
+
+/* out = a, with lane B taken from b */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_blend_B(bignum25519x4 out, const bignum25519x4 a, const bignum25519x4 b) {
+	int i;
+	for (i = 0; i < 5; i++)
+		out[i] = _mm256_blend_epi32(a[i], b[i], 0x0c);
+}
+
+/* out = a, with lane D taken from b */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_blend_D(bignum25519x4 out, const bignum25519x4 a, const bignum25519x4 b) {
+	int i;
+	for (i = 0; i < 5; i++)
+		out[i] = _mm256_blend_epi32(a[i], b[i], 0xc0);
+}
+
+/* out = a, with lanes B and D taken from b */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_blend_BD(bignum25519x4 out, const bignum25519x4 a, const bignum25519x4 b) {
+	int i;
+	for (i = 0; i < 5; i++)
+		out[i] = _mm256_blend_epi32(a[i], b[i], 0xcc);
+}
+
+/* out = a, with lanes C and D taken from b */
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_blend_CD(bignum25519x4 out, const bignum25519x4 a, const bignum25519x4 b) {
+	int i;
+	for (i = 0; i < 5; i++)
+		out[i] = _mm256_blend_epi32(a[i], b[i], 0xf0);
+}
+
+/*
+	(A,B,C,D) -> (B-A, B+A, D-C, D+C), carried. in must be carried. this has
+	to carry, B-A would not fit in the 52 bit multiplier
+*/
+DONNA_INLINE CURVE25519X4_FN static void
+curve25519x4_diff_sum(bignum25519x4 out, const bignum25519x4 in) {
+	bignum25519x4 swapped, sum;
+	curve25519x4_permute(swapped, in, &packed4_BADC);
+	curve25519x4_add(sum, in, swapped);
+	curve25519x4_sub(out, swapped, in);
+	curve25519x4_blend_BD(out, out, sum);
+	curve25519x4_carry(out);
+}
+
+#define madd(l, h, x, y) \
+	l = _mm256_madd52lo_epu64(l, x, y); \
+	h = _mm256_madd52hi_epu64(h, x, y);
+
+/*
+	out = a * b, carried. every limb of a and b must be below 2^52, which
+	holds for carried values and for curve25519x4_neg
+
+	the high halves of the 104 bit products sit at 2^52 above their limb, so
+	they are accumulated separately and doubled in to the next limb up
+*/
+CURVE25519X4_FN static void
+curve25519x4_mul(bignum25519x4 out, const bignum25519x4 a, const bignum25519x4 b) {
+	const ymmi zero = _mm256_setzero_si256();
+	ymmi l0,l1,l2,l3,l4,l5,l6,l7,l8, h0,h1,h2,h3,h4,h5,h6,h7,h8;
+	ymmi m1,m2,m3,m4,m5,m6,m7, g1,g2,g3,g4,g5,g6,g7;
+	ymmi z5,z6,z7,z8,z9;
+
+	/* rows 0, 2 and 4 in to l/h, rows 1 and 3 in to m/g, to keep the madd chains short */
+	l0 = l1 = l2 = l3 = l4 = l5 = l6 = l7 = l8 = zero;
+	h0 = h1 = h2 = h3 = h4 = h5 = h6 = h7 = h8 = zero;
+	m1 = m2 = m3 = m4 = m5 = m6 = m7 = zero;
+	g1 = g2 = g3 = g4 = g5 = g6 = g7 = zero;
+
+	madd(l0, h0, a[0], b[0]) madd(l1, h1, a[0], b[1]) madd(l2, h2, a[0], b[2]) madd(l3, h3, a[0], b[3]) madd(l4, h4, a[0], b[4])
+	madd(m1, g1, a[1], b[0]) madd(m2, g2, a[1], b[1]) madd(m3, g3, a[1], b[2]) madd(m4, g4, a[1], b[3]) madd(m5, g5, a[1], b[4])
+	madd(l2, h2, a[2], b[0]) madd(l3, h3, a[2], b[1]) madd(l4, h4, a[2], b[2]) madd(l5, h5, a[2], b[3]) madd(l6, h6, a[2], b[4])
+	madd(m3, g3, a[3], b[0]) madd(m4, g4, a[3], b[1]) madd(m5, g5, a[3], b[2]) madd(m6, g6, a[3], b[3]) madd(m7, g7, a[3], b[4])
+	madd(l4, h4, a[4], b[0]) madd(l5, h5, a[4], b[1]) madd(l6, h6, a[4], b[2]) madd(l7, h7, a[4], b[3]) madd(l8, h8, a[4], b[4])
+
+	l1 = _mm256_add_epi64(l1, m1); h1 = _mm256_add_epi64(h1, g1);
+	l2 = _mm256_add_epi64(l2, m2); h2 = _mm256_add_epi64(h2, g2);
+	l3 = _mm256_add_epi64(l3, m3); h3 = _mm256_add_epi64(h3, g3);
+	l4 = _mm256_add_epi64(l4, m4); h4 = _mm256_add_epi64(h4, g4);
+	l5 = _mm256_add_epi64(l5, m5); h5 = _mm256_add_epi64(h5, g5);
+	l6 = _mm256_add_epi64(l6, m6); h6 = _mm256_add_epi64(h6, g6);
+	l7 = _mm256_add_epi64(l7, m7); h7 = _mm256_add_epi64(h7, g7);
+
+	/* limb k = l[k] + 2*h[k-1] */
+	z5 = _mm256_add_epi64(l5, _mm256_slli_epi64(h4, 1));
+	z6 = _mm256_add_epi64(l6, _mm256_slli_epi64(h5, 1));
+	z7 = _mm256_add_epi64(l7, _mm256_slli_epi64(h6, 1));
+	z8 = _mm256_add_epi64(l8, _mm256_slli_epi64(h7, 1));
+	z9 = _mm256_slli_epi64(h8, 1);
+
+	/* fold limbs 5..9 back in, 2^255 = 19 */
+	#define mul19(x) _mm256_add_epi64(x, _mm256_add_epi64(_mm256_slli_epi64(x, 1), _mm256_slli_epi64(x, 4)))
+	out[0] = _mm256_add_epi64(l0, mul19(z5));
+	out[1] = _mm256_add_epi64(_mm256_add_epi64(l1, _mm256_slli_epi64(h0, 1)), mul19(z6));
+	out[2] = _mm256_add_epi64(_mm256_add_epi64(l2, _mm256_slli_epi64(h1, 1)), mul19(z7));
+	out[3] = _mm256_add_epi64(_mm256_add_epi64(l3, _mm256_slli_epi64(h2, 1)), mul19(z8));
+	out[4] = _mm256_add_epi64(_mm256_add_epi64(l4, _mm256_slli_epi64(h3, 1)), mul19(z9));
+	#undef mul19
+
+	curve25519x4_carry(out);
+}
+
+/*
+	out = a * a, carried. the 10 cross products are accumulated once and
+	doubled afterwards rather than multiplied by 2a, which could exceed the
+	52 bits the multiplier reads, so a square is 15 products instead of 25.
+	point arithmetic is latency bound and gains little from it, long chains
+	of squarings on independent lanes are throughput bound and gain a lot
+*/
+CURVE25519X4_FN static void
+curve25519x4_square(bignum25519x4 out, const bignum25519x4 a) {
+	const ymmi zero = _mm256_setzero_si256();
+	ymmi l0,l1,l2,l3,l4,l5,l6,l7,l8, h0,h1,h2,h3,h4,h5,h6,h7,h8;
+	ymmi m2,m4,m6,m8, g2,g4,g6,g8;
+	ymmi z5,z6,z7,z8,z9;
+
+	/* cross products in to l/h, squares in to m/g (and l0/h0) */
+	l0 = l1 = l2 = l3 = l4 = l5 = l6 = l7 = l8 = zero;
+	h0 = h1 = h2 = h3 = h4 = h5 = h6 = h7 = h8 = zero;
+	m2 = m4 = m6 = m8 = zero;
+	g2 = g4 = g6 = g8 = zero;
+
+	madd(l1, h1, a[0], a[1]) madd(l2, h2, a[0], a[2]) madd(l3, h3, a[0], a[3]) madd(l4, h4, a[0], a[4])
+	madd(l3, h3, a[1], a[2]) madd(l4, h4, a[1], a[3]) madd(l5, h5, a[1], a[4])
+	madd(l5, h5, a[2], a[3]) madd(l6, h6, a[2], a[4])
+	madd(l7, h7, a[3], a[4])
+	madd(l0, h0, a[0], a[0]) madd(m2, g2, a[1], a[1]) madd(m4, g4, a[2], a[2]) madd(m6, g6, a[3], a[3]) madd(m8, g8, a[4], a[4])
+
+	l1 = _mm256_slli_epi64(l1, 1); h1 = _mm256_slli_epi64(h1, 1);
+	l2 = _mm256_add_epi64(_mm256_slli_epi64(l2, 1), m2); h2 = _mm256_add_epi64(_mm256_slli_epi64(h2, 1), g2);
+	l3 = _mm256_slli_epi64(l3, 1); h3 = _mm256_slli_epi64(h3, 1);
+	l4 = _mm256_add_epi64(_mm256_slli_epi64(l4, 1), m4); h4 = _mm256_add_epi64(_mm256_slli_epi64(h4, 1), g4);
+	l5 = _mm256_slli_epi64(l5, 1); h5 = _mm256_slli_epi64(h5, 1);
+	l6 = _mm256_add_epi64(_mm256_slli_epi64(l6, 1), m6); h6 = _mm256_add_epi64(_mm256_slli_epi64(h6, 1), g6);
+	l7 = _mm256_slli_epi64(l7, 1); h7 = _mm256_slli_epi64(h7, 1);
+	l8 = m8; h8 = g8;
+
+	/* limb k = l[k] + 2*h[k-1] */
+	z5 = _mm256_add_epi64(l5, _mm256_slli_epi64(h4, 1));
+	z6 = _mm256_add_epi64(l6, _mm256_slli_epi64(h5, 1));
+	z7 = _mm256_add_epi64(l7, _mm256_slli_epi64(h6, 1));
+	z8 = _mm256_add_epi64(l8, _mm256_slli_epi64(h7, 1));
+	z9 = _mm256_slli_epi64(h8, 1);
+
+	/* fold limbs 5..9 back in, 2^255 = 19 */
+	#define mul19(x) _mm256_add_epi64(x, _mm256_add_epi64(_mm256_slli_epi64(x, 1), _mm256_slli_epi64(x, 4)))
+	out[0] = _mm256_add_epi64(l0, mul19(z5));
+	out[1] = _mm256_add_epi64(_mm256_add_epi64(l1, _mm256_slli_epi64(h0, 1)), mul19(z6));
+	out[2] = _mm256_add_epi64(_mm256_add_epi64(l2, _mm256_slli_epi64(h1, 1)), mul19(z7));
+	out[3] = _mm256_add_epi64(_mm256_add_epi64(l3, _mm256_slli_epi64(h2, 1)), mul19(z8));
+	out[4] = _mm256_add_epi64(_mm256_add_epi64(l4, _mm256_slli_epi64(h3, 1)), mul19(z9));
+	#undef mul19
+
+	curve25519x4_carry(out);
+}
+
+#undef madd
+
+/* out = (a, b, c, d) in lanes A, B, C and D. the inputs may be unreduced */
+CURVE25519X4_FN static void
+curve25519x4_pack(bignum25519x4 out, const bignum25519 a, const bignum25519 b, const bignum25519 c, const bignum25519 d) {
+	int i;
+	for (i = 0; i < 5; i++)
+		out[i] = _mm256_set_epi64x((int64_t)d[i], (int64_t)c[i], (int64_t)b[i], (int64_t)a[i]);
+	curve25519x4_carry(out);
+}
+
+/* (a, b, c, d) = lanes A, B, C and D of in */
+CURVE25519X4_FN static void
+curve25519x4_unpack(bignum25519 a, bignum25519 b, bignum25519 c, bignum25519 d, const bignum25519x4 in) {
+	packedelem64x4 ALIGN(32) v;
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		v.v = in[i];
+		a[i] = v.u[0];
+		b[i] = v.u[1];
+		c[i] = v.u[2];
+		d[i] = v.u[3];
+	}
+}
@@ -0,0 +1,236 @@
+/*
+	Runtime backend selection for the Ed25519 API
+
+	ed25519.c is compiled once per backend with ED25519_SUFFIX set to the
+	backend name and ED25519_DISPATCH defined, and this file provides the
+	unsuffixed public functions, forwarding each call to the fastest backend
+	the running cpu supports. The backend is chosen once, on the first call or
+	when the library loads.
+
+	Backends other than the generic one are enabled with
+	ED25519_DISPATCH_<NAME>, in the order they are preferred.
+*/
+
+#include "ed25519-donna-portable.h"
+#include "ed25519.h"
+
+#define ED25519_DISPATCH_DECLARE(suffix) \
+	void ed25519_publickey##suffix(const ed25519_secret_key sk, ed25519_public_key pk); \
+	int ed25519_sign_open##suffix(const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS); \
+	void ed25519_sign##suffix(const unsigned char *m, size_t mlen, const ed25519_secret_key sk, const ed25519_public_key pk, ed25519_signature RS); \
+	void ed25519_publickey_batch##suffix(const unsigned char **sk, unsigned char **pk, size_t num); \
+	void ed25519_sign_batch##suffix(const unsigned char **m, size_t *mlen, const unsigned char **sk, const unsigned char **pk, unsigned char **RS, size_t num); \
+	int ed25519_sign_open_batch##suffix(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid); \
+	size_t ed25519_sign_open_batch_scratch_size##suffix(size_t num); \
+	int ed25519_sign_open_batch_scratch##suffix(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, void *scratch, size_t scratch_size); \
+	int ed25519_sign_open_batch_mt##suffix(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, size_t nthreads); \
+	ed25519_batch *ed25519_batch_init##suffix(void); \
+	int ed25519_batch_add##suffix(ed25519_batch *ctx, const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS); \
+	int ed25519_batch_finalize##suffix(ed25519_batch *ctx, int *valid); \
+	void ed25519_randombytes_unsafe##suffix(void *out, size_t count); \
+	void curved25519_scalarmult_basepoint##suffix(curved25519_key pk, const curved25519_key e); \
+	void curved25519_scalarmult_basepoint_batch##suffix(curved25519_key *pk, const curved25519_key *e, size_t num); \
+	const char *ed25519_backend##suffix(void);
+
+#define ED25519_DISPATCH_IMPL(suffix) { \
+	ed25519_publickey##suffix, \
+	ed25519_sign_open##suffix, \
+	ed25519_sign##suffix, \
+	ed25519_publickey_batch##suffix, \
+	ed25519_sign_batch##suffix, \
+	ed25519_sign_open_batch##suffix, \
+	ed25519_sign_open_batch_scratch_size##suffix, \
+	ed25519_sign_open_batch_scratch##suffix, \
+	ed25519_sign_open_batch_mt##suffix, \
+	ed25519_batch_init##suffix, \
+	ed25519_batch_add##suffix, \
+	ed25519_batch_finalize##suffix, \
+	curved25519_scalarmult_basepoint##suffix, \
+	curved25519_scalarmult_basepoint_batch##suffix, \
+	ed25519_backend##suffix \
+}
+
+typedef struct ed25519_impl_t {
+	void (*publickey)(const ed25519_secret_key sk, ed25519_public_key pk);
+	int (*sign_open)(const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS);
+	void (*sign)(const unsigned char *m, size_t mlen, const ed25519_secret_key sk, const ed25519_public_key pk, ed25519_signature RS);
+	void (*publickey_batch)(const unsigned char **sk, unsigned char **pk, size_t num);
+	void (*sign_batch)(const unsigned char **m, size_t *mlen, const unsigned char **sk, const unsigned char **pk, unsigned char **RS, size_t num);
+	int (*sign_open_batch)(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid);
+	size_t (*sign_open_batch_scratch_size)(size_t num);
+	int (*sign_open_batch_scratch)(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, void *scratch, size_t scratch_size);
+	int (*sign_open_batch_mt)(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, size_t nthreads);
+	ed25519_batch *(*batch_init)(void);
+	int (*batch_add)(ed25519_batch *ctx, const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS);
+	int (*batch_finalize)(ed25519_batch *ctx, int *valid);
+	void (*scalarmult_basepoint)(curved25519_key pk, const curved25519_key e);
+	void (*scalarmult_basepoint_batch)(curved25519_key *pk, const curved25519_key *e, size_t num);
+	const char *(*backend)(void);
+} ed25519_impl;
+
+ED25519_DISPATCH_DECLARE(_generic)
+static const ed25519_impl ed25519_impl_generic = ED25519_DISPATCH_IMPL(_generic);
+
+#if defined(ED25519_DISPATCH_SSE2)
+ED25519_DISPATCH_DECLARE(_sse2)
+static const ed25519_impl ed25519_impl_sse2 = ED25519_DISPATCH_IMPL(_sse2);
+#endif
+
+/* the suffixed builds only declare this, there is one copy for the tests to look at */
+unsigned char batch_point_buffer[3][32];
+
+/* in the order they are preferred, the generic backend runs everywhere */
+static const struct {
+	const char *name;
+	const ed25519_impl *impl;
+} ed25519_impls[] = {
+#if defined(ED25519_DISPATCH_SSE2)
+	{"sse2", &ed25519_impl_sse2},
+#endif
+	{"generic", &ed25519_impl_generic}
+};
+
+static int
+ed25519_impl_supported(const ed25519_impl *impl) {
+#if defined(ED25519_DISPATCH_SSE2)
+	if (impl == &ed25519_impl_sse2) {
+	#if (defined(COMPILER_GCC) || defined(COMPILER_CLANG)) && (defined(CPU_X86) || defined(CPU_X86_64))
+		return __builtin_cpu_supports("sse2");
+	#else
+		return 0;
+	#endif
+	}
+#endif
+	(void)impl;
+	return 1;
+}
+
+/*
+	ED25519_BACKEND=<name> in the environment picks one of the backends
+	built in, by its name in ED25519_DISPATCH_BACKENDS, if the cpu supports
+	it. This lets the tests run every backend on one machine
+*/
+static const ed25519_impl *
+ed25519_resolve(void) {
+	const char *name = getenv("ED25519_BACKEND");
+	size_t i, count = sizeof(ed25519_impls) / sizeof(ed25519_impls[0]);
+
+	if (name) {
+		for (i = 0; i < count; i++) {
+			if (!strcmp(name, ed25519_impls[i].name) && ed25519_impl_supported(ed25519_impls[i].impl))
+				return ed25519_impls[i].impl;
+		}
+	}
+	for (i = 0; i < count - 1; i++) {
+		if (ed25519_impl_supported(ed25519_impls[i].impl))
+			break;
+	}
+	return ed25519_impls[i].impl;
+}
+
+static const ed25519_impl *ed25519_selected;
+
+#if defined(COMPILER_GCC) || defined(COMPILER_CLANG)
+/* resolve once while the library loads, before any thread can call in */
+__attribute__((constructor)) static void
+ed25519_select_init(void) {
+#if defined(CPU_X86) || defined(CPU_X86_64)
+	__builtin_cpu_init();
+#endif
+	ed25519_selected = ed25519_resolve();
+}
+#endif
+
+/*
+	without a constructor, or when called from a constructor that ran
+	first, the first call resolves. every caller stores the same pointer
+*/
+static const ed25519_impl *
+ed25519_select(void) {
+	if (!ed25519_selected)
+		ed25519_selected = ed25519_resolve();
+	return ed25519_selected;
+}
+
+void
+ed25519_publickey(const ed25519_secret_key sk, ed25519_public_key pk) {
+	ed25519_select()->publickey(sk, pk);
+}
+
+int
+ed25519_sign_open(const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS) {
+	return ed25519_select()->sign_open(m, mlen, pk, RS);
+}
+
+void
+ed25519_sign(const unsigned char *m, size_t mlen, const ed25519_secret_key sk, const ed25519_public_key pk, ed25519_signature RS) {
+	ed25519_select()->sign(m, mlen, sk, pk, RS);
+}
+
+void
+ed25519_publickey_batch(const unsigned char **sk, unsigned char **pk, size_t num) {
+	ed25519_select()->publickey_batch(sk, pk, num);
+}
+
+void
+ed25519_sign_batch(const unsigned char **m, size_t *mlen, const unsigned char **sk, const unsigned char **pk, unsigned char **RS, size_t num) {
+	ed25519_select()->sign_batch(m, mlen, sk, pk, RS, num);
+}
+
+int
+ed25519_sign_open_batch(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid) {
+	return ed25519_select()->sign_open_batch(m, mlen, pk, RS, num, valid);
+}
+
+/* the size can differ between backends, so it must come from the one that uses the scratch */
+size_t
+ed25519_sign_open_batch_scratch_size(size_t num) {
+	return ed25519_select()->sign_open_batch_scratch_size(num);
+}
+
+int
+ed25519_sign_open_batch_scratch(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, void *scratch, size_t scratch_size) {
+	return ed25519_select()->sign_open_batch_scratch(m, mlen, pk, RS, num, valid, scratch, scratch_size);
+}
+
+int
+ed25519_sign_open_batch_mt(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, size_t nthreads) {
+	return ed25519_select()->sign_open_batch_mt(m, mlen, pk, RS, num, valid, nthreads);
+}
+
+/* a batch is only ever handed back to the backend that created it, which the selection always returns */
+ed25519_batch *
+ed25519_batch_init(void) {
+	return ed25519_select()->batch_init();
+}
+
+int
+ed25519_batch_add(ed25519_batch *ctx, const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS) {
+	return ed25519_select()->batch_add(ctx, m, mlen, pk, RS);
+}
+
+int
+ed25519_batch_finalize(ed25519_batch *ctx, int *valid) {
+	return ed25519_select()->batch_finalize(ctx, valid);
+}
+
+/* the random source does not depend on the backend */
+void
+ed25519_randombytes_unsafe(void *out, size_t count) {
+	ed25519_randombytes_unsafe_generic(out, count);
+}
+
+void
+curved25519_scalarmult_basepoint(curved25519_key pk, const curved25519_key e) {
+	ed25519_select()->scalarmult_basepoint(pk, e);
+}
+
+void
+curved25519_scalarmult_basepoint_batch(curved25519_key *pk, const curved25519_key *e, size_t num) {
+	ed25519_select()->scalarmult_basepoint_batch(pk, e, num);
+}
+
+const char *
+ed25519_backend(void) {
+	return ed25519_select()->backend();
+}
@@ -5,14 +5,85 @@
 #define max_batch_size 64
 #define heap_batch_size ((max_batch_size * 2) + 1)
 
+/*
+	batches of at least this many signatures are verified as a single random
+	linear combination with pippenger, in heap or caller provided scratch.
+	smaller batches are verified max_batch_size at a time with bos-coster on
+	the stack. the combination is already as fast at 64 signatures on the 64
+	bit backend (24 with ifma), so anything that does not fit one chunk uses it
+*/
+#if !defined(ed25519_batch_pippenger_threshold)
+#define ed25519_batch_pippenger_threshold (max_batch_size + 1)
+#endif
+
 /* which limb is the 128th bit in? */
 static const size_t limb128bits = (128 + bignum256modm_bits_per_limb - 1) / bignum256modm_bits_per_limb;
 
 typedef size_t heap_index_t;
 
+#if defined(ED25519_X4)
+
+/* keep the points packed when the 4-way backend is usable so every bos-coster addition runs on it */
+typedef union batch_point_t {
+	ge25519 p;
+	ge25519x4 v;
+} batch_point;
+
+CURVE25519X4_FN static void
+batch_point_add_x4(batch_point *r, const batch_point *p, const batch_point *q) {
+	ge25519x4_cached t;
+	ge25519x4_to_cached(&t, &q->v);
+	ge25519x4_add(&r->v, &p->v, &t);
+}
+
+static void
+batch_point_set(batch_point *r, const ge25519 *p) {
+	if (curve25519x4_available())
+		ge25519x4_pack(&r->v, p);
+	else
+		r->p = *p;
+}
+
+static void
+batch_point_get(ge25519 *r, const batch_point *p) {
+	if (curve25519x4_available())
+		ge25519x4_unpack(r, &p->v);
+	else
+		*r = p->p;
+}
+
+static void
+batch_point_add(batch_point *r, const batch_point *p, const batch_point *q) {
+	if (curve25519x4_available())
+		batch_point_add_x4(r, p, q);
+	else
+		ge25519_add(&r->p, &p->p, &q->p);
+}
+
+#else
+
+typedef ge25519 batch_point;
+
+static void
+batch_point_set(batch_point *r, const ge25519 *p) {
+	*r = *p;
+}
+
+static void
+batch_point_get(ge25519 *r, const batch_point *p) {
+	*r = *p;
+}
+
+static void
+batch_point_add(batch_point *r, const batch_point *p, const batch_point *q) {
+	ge25519_add(r, p, q);
+}
+
+#endif
+
 typedef struct batch_heap_t {
 	unsigned char r[heap_batch_size][16]; /* 128 bit random values */
-	ge25519 points[heap_batch_size];
+	batch_point points[heap_batch_size];
 	bignum256modm scalars[heap_batch_size];
 	heap_index_t heap[heap_batch_size];
 	size_t size;
@@ -147,10 +218,11 @@ ge25519_multi_scalarmult_vartime_final(ge25519 *r, ge25519 *point, bignum256modm
 	}
 }
 
-/* count must be >= 5 */
+/* count must be odd and >= 5 */
 static void
 ge25519_multi_scalarmult_vartime(ge25519 *r, batch_heap *heap, size_t count) {
 	heap_index_t max1, max2;
+	ge25519 ALIGN(16) last;
 
 	/* start with the full limb size */
 	size_t limbsize = bignum256modm_limb_size - 1;
@@ -180,15 +252,23 @@ ge25519_multi_scalarmult_vartime(ge25519 *r, batch_heap *heap, size_t count) {
 		}
 
 		sub256_modm_batch(heap->scalars[max1], heap->scalars[max1], heap->scalars[max2], limbsize);
-		ge25519_add(&heap->points[max2], &heap->points[max2], &heap->points[max1]);
+		batch_point_add(&heap->points[max2], &heap->points[max2], &heap->points[max1]);
 		heap_updated_root(heap, limbsize);
 	}
 
-	ge25519_multi_scalarmult_vartime_final(r, &heap->points[max1], heap->scalars[max1]);
+	batch_point_get(&last, &heap->points[max1]);
+	ge25519_multi_scalarmult_vartime_final(r, &last, heap->scalars[max1]);
 }
 
-/* not actually used for anything other than testing */
+/*
+	not actually used for anything other than testing. only the batches
+	verified on the calling thread write it
+*/
+#if defined(ED25519_DISPATCH)
+extern unsigned char batch_point_buffer[3][32];
+#else
 unsigned char batch_point_buffer[3][32];
+#endif
 
 static int
 ge25519_is_neutral_vartime(const ge25519 *p) {
@@ -197,66 +277,343 @@ ge25519_is_neutral_vartime(const ge25519 *p) {
 	curve25519_contract(point_buffer[0], p->x);
 	curve25519_contract(point_buffer[1], p->y);
 	curve25519_contract(point_buffer[2], p->z);
-	memcpy(batch_point_buffer[1], point_buffer[1], 32);
 	return (memcmp(point_buffer[0], zero, 32) == 0) && (memcmp(point_buffer[1], point_buffer[2], 32) == 0);
 }
 
-int
-ED25519_FN(ed25519_sign_open_batch) (const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid) {
-	batch_heap ALIGN(16) batch;
-	ge25519 ALIGN(16) p;
-	bignum256modm *r_scalars;
-	size_t i, batchsize;
+/* failing runs of signatures are bisected down to this many, which are verified one by one */
+#if !defined(ed25519_batch_bisect_leaf_size)
+#define ed25519_batch_bisect_leaf_size 4
+#endif
+
+/* key[i] of a signature whose points failed to decode, it has no terms */
+#define ed25519_batch_no_key ((size_t)-1)
+
+/*
+	the terms of a batch. index 0 is unused, signature i has -A[i] at 2i+1
+	and -R[i] at 2i+2, r[i]*H(R[i],A[i],m[i]) and r[i] at the same places in
+	scalars. rs[i] is r[i]*S[i], and hram[i] is H(R[i],A[i],m[i]) to verify the
+	signature on its own.
+
+	signatures under the same public key share the first one's decoded key:
+	key[i] is the index of the first signature with pk[i], and only that one
+	has -A at 2i+1. table finds the earlier signatures by their key, and the
+	A terms are summed per key when a run is multiplied out
+*/
+typedef struct ed25519_batch_terms_t {
+	ge25519 *points;
+	bignum256modm *scalars;
+	bignum256modm *rs;
+	bignum256modm *hram;
+	unsigned char (*pk)[32];
+	size_t *key;
+	size_t *slot; /* for the first signature of a key, its term in the run being multiplied out */
+	size_t *table; /* open addressing, 1 + the first signature of the key, 0 if empty */
+	size_t table_mask; /* at least twice the signatures, so the table never fills up */
+	uint32_t seed;
+	batch_heap *heap; /* bos-coster, for runs of up to max_batch_size signatures */
+	ge25519 *work_points; /* the terms of longer runs for pippenger, NULL if there are none */
+	bignum256modm *work_scalars;
+	void *pippenger;
+} ed25519_batch_terms;
+
+static void
+ed25519_batch_randombytes(unsigned char (*r)[16], size_t num) {
+#if defined(ED25519_DISPATCH)
+	/* every backend draws from the one random source the dispatcher exports */
+	ed25519_randombytes_unsafe(r, num * 16);
+#else
+	ED25519_FN(ed25519_randombytes_unsafe) (r, num * 16);
+#endif
+}
+
+/*
+	the public keys are chosen by whoever submits the signatures, so they are
+	hashed with a seed derived from the secret random values to keep anyone
+	from lining up their probe sequences
+*/
+static size_t
+ed25519_batch_key_find(const ed25519_batch_terms *b, const unsigned char *pk) {
+	uint32_t h = b->seed;
+	size_t i;
+
+	for (i = 0; i < 32; i += 4) {
+		h ^= (uint32_t)pk[i] | ((uint32_t)pk[i + 1] << 8) | ((uint32_t)pk[i + 2] << 16) | ((uint32_t)pk[i + 3] << 24);
+		h *= 0x9e3779b1;
+		h ^= h >> 15;
+	}
+
+	/* the position of the key, or the empty one to insert it at */
+	for (i = h & b->table_mask; b->table[i] && memcmp(b->pk[b->table[i] - 1], pk, 32); i = (i + 1) & b->table_mask)
+		;
+	return i;
+}
+
+/*
+	hash, expand and decode the num signatures in to b from signature first,
+	with the 128 bit random values r. the table is started over with signature
+	0. valid[first + i] is set to 1, unless a point fails to decode: then the
+	signature is verified on its own and left out of the terms. returns 1 if
+	any of those failed, 0 otherwise
+*/
+static int
+ed25519_batch_prepare(ed25519_batch_terms *b, size_t first, const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, const unsigned char (*r)[16], int *valid) {
+	bignum256modm s;
 	unsigned char hram[64];
-	int ret = 0;
+	size_t i, n, pos;
+	int ret = 0, decoded;
 
-	for (i = 0; i < num; i++)
-		valid[i] = 1;
+	if (first == 0) {
+		ed25519_hash(hram, r[0], 16);
+		b->seed = (uint32_t)hram[0] | ((uint32_t)hram[1] << 8) | ((uint32_t)hram[2] << 16) | ((uint32_t)hram[3] << 24);
+		memset(b->table, 0, (b->table_mask + 1) * sizeof(size_t));
+	}
 
-	while (num > 3) {
-		batchsize = (num > max_batch_size) ? max_batch_size : num;
+	for (i = 0, n = first; i < num; i++, n++) {
+		expand256_modm(b->scalars[(n * 2) + 2], r[i], 16);
+		expand256_modm(s, RS[i] + 32, 32);
+		mul256_modm(b->rs[n], s, b->scalars[(n * 2) + 2]);
+
+		ed25519_hram(hram, RS[i], pk[i], m[i], mlen[i]);
+		expand256_modm(b->hram[n], hram, 64);
+		mul256_modm(b->scalars[(n * 2) + 1], b->hram[n], b->scalars[(n * 2) + 2]);
+
+		memcpy(b->pk[n], pk[i], 32);
+		pos = ed25519_batch_key_find(b, pk[i]);
+		if (b->table[pos]) {
+			b->key[n] = b->table[pos] - 1;
+			decoded = 1;
+		} else {
+			b->key[n] = n;
+			b->slot[n] = ed25519_batch_no_key;
+			decoded = ge25519_unpack_negative_vartime(&b->points[(n * 2) + 1], pk[i]);
+		}
+
+		valid[n] = 1;
+		if (!decoded || !ge25519_unpack_negative_vartime(&b->points[(n * 2) + 2], RS[i])) {
+			valid[n] = ED25519_FN(ed25519_sign_open) (m[i], mlen[i], pk[i], RS[i]) ? 0 : 1;
+			ret |= (valid[n] ^ 1);
+			b->key[n] = ed25519_batch_no_key;
+			memset(b->rs[n], 0, sizeof(bignum256modm));
+			continue;
+		}
+
+		if (!b->table[pos])
+			b->table[pos] = n + 1;
+	}
+	return ret;
+}
 
-		/* generate r (scalars[batchsize+1]..scalars[2*batchsize] */
-		ED25519_FN(ed25519_randombytes_unsafe) (batch.r, batchsize * 16);
-		r_scalars = &batch.scalars[batchsize + 1];
-		for (i = 0; i < batchsize; i++)
-			expand256_modm(r_scalars[i], batch.r[i], 16);
+/* set term n of the run being multiplied out, in the bos-coster heap or the terms for pippenger */
+static void
+ed25519_batch_term_set(ed25519_batch_terms *b, int heap, size_t n, const ge25519 *point, const bignum256modm scalar) {
+	if (heap) {
+		batch_point_set(&b->heap->points[n], point);
+		memcpy(b->heap->scalars[n], scalar, sizeof(bignum256modm));
+	} else {
+		b->work_points[n] = *point;
+		memcpy(b->work_scalars[n], scalar, sizeof(bignum256modm));
+	}
+}
+
+/*
+	r = [r1s1 + r2s2 + ...]B - [r1H1 + ...]A1 - ... - [r1]R1 - ... over the count
+	signatures from lo, with one A term per distinct key in the run
+*/
+static void
+ed25519_batch_msm(ge25519 *r, ed25519_batch_terms *b, size_t lo, size_t count) {
+	static const bignum256modm zero = {0};
+	bignum256modm_element_t *scalar;
+	bignum256modm sum;
+	size_t i, k, n = 1;
+	int heap = (count <= max_batch_size);
 
-		/* compute scalars[0] = ((r1s1 + r2s2 + ...)) */
-		for (i = 0; i < batchsize; i++) {
-			expand256_modm(batch.scalars[i], RS[i] + 32, 32);
-			mul256_modm(batch.scalars[i], batch.scalars[i], r_scalars[i]);
+	memset(sum, 0, sizeof(bignum256modm));
+	for (i = lo; i < lo + count; i++)
+		add256_modm(sum, sum, b->rs[i]);
+	ed25519_batch_term_set(b, heap, 0, &ge25519_basepoint, sum);
+
+	/* the full scalars go first, bos-coster extends the heap with the 128 bit ones later */
+	for (i = lo; i < lo + count; i++) {
+		k = b->key[i];
+		if (k == ed25519_batch_no_key)
+			continue;
+		if (b->slot[k] == ed25519_batch_no_key) {
+			b->slot[k] = n;
+			ed25519_batch_term_set(b, heap, n++, &b->points[(k * 2) + 1], b->scalars[(i * 2) + 1]);
+		} else {
+			scalar = heap ? b->heap->scalars[b->slot[k]] : b->work_scalars[b->slot[k]];
+			add256_modm(scalar, scalar, b->scalars[(i * 2) + 1]);
 		}
-		for (i = 1; i < batchsize; i++)
-			add256_modm(batch.scalars[0], batch.scalars[0], batch.scalars[i]);
-
-		/* compute scalars[1]..scalars[batchsize] as r[i]*H(R[i],A[i],m[i]) */
-		for (i = 0; i < batchsize; i++) {
-			ed25519_hram(hram, RS[i], pk[i], m[i], mlen[i]);
-			expand256_modm(batch.scalars[i+1], hram, 64);
-			mul256_modm(batch.scalars[i+1], batch.scalars[i+1], r_scalars[i]);
+	}
+	for (i = lo; i < lo + count; i++) {
+		if (b->key[i] != ed25519_batch_no_key)
+			ed25519_batch_term_set(b, heap, n++, &b->points[(i * 2) + 2], b->scalars[(i * 2) + 2]);
+	}
+	for (i = lo; i < lo + count; i++) {
+		if (b->key[i] != ed25519_batch_no_key)
+			b->slot[b->key[i]] = ed25519_batch_no_key;
+	}
+
+	/* bos-coster needs an odd number of at least 5 terms, the heap is only sifted through pairs of children */
+	while ((n < 5) || !(n & 1))
+		ed25519_batch_term_set(b, heap, n++, &ge25519_basepoint, zero);
+
+	if (heap)
+		ge25519_multi_scalarmult_vartime(r, b->heap, n);
+	else
+		ge25519_multiscalarmult_pippenger_vartime_scratch(r, b->work_points, b->work_scalars, n, b->pippenger);
+}
+
+/*
+	verifying one signature on its own costs about this many signatures worth
+	of multiscalar multiplication when bisecting
+*/
+#if !defined(ed25519_batch_bisect_verify_cost)
+#define ed25519_batch_bisect_verify_cost 4
+#endif
+
+/*
+	the halves multiplied out so far at each depth of the bisection, and how
+	many of them were neutral. a run is only split if enough halves of that
+	size come out clean to pay for multiplying one out
+*/
+typedef struct ed25519_batch_bisect_stats_t {
+	size_t tested[64], clean[64];
+} ed25519_batch_bisect_stats;
+
+/*
+	ed25519_sign_open on the count signatures from lo, reusing the decoded key
+	and the hash. signatures which failed to decode were already verified
+*/
+static int
+ed25519_batch_verify_each(ed25519_batch_terms *b, const unsigned char **RS, size_t lo, size_t count, int *valid) {
+	ge25519 ALIGN(16) R;
+	bignum256modm S;
+	unsigned char checkR[32];
+	size_t i;
+	int ret = 0;
+
+	for (i = lo; i < lo + count; i++) {
+		if (b->key[i] == ed25519_batch_no_key) {
+			ret |= (valid[i] ^ 1);
+			continue;
 		}
 
-		/* compute points */
-		batch.points[0] = ge25519_basepoint;
-		for (i = 0; i < batchsize; i++)
-			if (!ge25519_unpack_negative_vartime(&batch.points[i+1], pk[i]))
-				goto fallback;
-		for (i = 0; i < batchsize; i++)
-			if (!ge25519_unpack_negative_vartime(&batch.points[batchsize+i+1], RS[i]))
-				goto fallback;
-
-		ge25519_multi_scalarmult_vartime(&p, &batch, (batchsize * 2) + 1);
-		if (!ge25519_is_neutral_vartime(&p)) {
-			ret |= 2;
-
-			fallback:
-			for (i = 0; i < batchsize; i++) {
-				valid[i] = ED25519_FN(ed25519_sign_open) (m[i], mlen[i], pk[i], RS[i]) ? 0 : 1;
-				ret |= (valid[i] ^ 1);
-			}
+		valid[i] = 0;
+		if (!(RS[i][63] & 224)) {
+			expand256_modm(S, RS[i] + 32, 32);
+			ge25519_double_scalarmult_vartime(&R, &b->points[(b->key[i] * 2) + 1], b->hram[i], S);
+			ge25519_pack(checkR, &R);
+			valid[i] = ed25519_verify(RS[i], checkR, 32);
 		}
+		ret |= (valid[i] ^ 1);
+	}
+	return ret;
+}
 
+/*
+	p is the combination over the count signatures from lo, depth splits down,
+	and is not neutral. only the left half is multiplied out, the right half is
+	p minus the left. halves which are neutral stay valid, the others are split
+	again until they are small enough to verify one by one. returns 1 if any
+	signature failed
+*/
+static int
+ed25519_batch_bisect(ed25519_batch_terms *b, const ge25519 *p, const unsigned char **RS, size_t lo, size_t count, size_t depth, ed25519_batch_bisect_stats *stats, int *valid) {
+	ge25519 ALIGN(16) left, right;
+	size_t half = count / 2, tested, clean;
+	int left_failed, right_failed, ret = 0;
+
+	if (count <= ed25519_batch_bisect_leaf_size)
+		return ed25519_batch_verify_each(b, RS, lo, count, valid);
+
+	/*
+		splitting costs half a run of multiplication and saves verifying a
+		clean half, so it pays while more than 1 in 2*verify_cost halves are
+		clean. the estimate starts at 1 in 2, sparse forgeries are always split
+		down and dense ones fall back after a couple of runs at each depth
+	*/
+	tested = stats->tested[depth + 1] + 2;
+	clean = stats->clean[depth + 1] + 1;
+	if ((clean * 2 * ed25519_batch_bisect_verify_cost) <= tested)
+		return ed25519_batch_verify_each(b, RS, lo, count, valid);
+
+	ed25519_batch_msm(&left, b, lo, half);
+	right = left;
+	curve25519_neg(right.x, right.x);
+	curve25519_neg(right.t, right.t);
+	ge25519_add(&right, p, &right);
+
+	left_failed = !ge25519_is_neutral_vartime(&left);
+	right_failed = !ge25519_is_neutral_vartime(&right);
+	stats->tested[depth + 1] += 2;
+	stats->clean[depth + 1] += (left_failed ^ 1) + (right_failed ^ 1);
+
+	if (left_failed)
+		ret |= ed25519_batch_bisect(b, &left, RS, lo, half, depth + 1, stats, valid);
+	if (right_failed)
+		ret |= ed25519_batch_bisect(b, &right, RS, lo + half, count - half, depth + 1, stats, valid);
+	return ret;
+}
+
+/* check the combination of the count prepared signatures from lo, and bisect it if it fails. record is set off the worker threads */
+static int
+ed25519_batch_check(ed25519_batch_terms *b, const unsigned char **RS, size_t lo, size_t count, int record, int *valid) {
+	ge25519 ALIGN(16) p;
+	ed25519_batch_bisect_stats stats;
+
+	ed25519_batch_msm(&p, b, lo, count);
+	if (record)
+		curve25519_contract(batch_point_buffer[1], p.y);
+	if (ge25519_is_neutral_vartime(&p))
+		return 0;
+	memset(&stats, 0, sizeof(stats));
+	return 2 | ed25519_batch_bisect(b, &p, RS, lo, count, 0, &stats, valid);
+}
+
+static int
+ed25519_batch_verify_terms(ed25519_batch_terms *b, const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, const unsigned char (*r)[16], int record, int *valid) {
+	int ret;
+
+	ret = ed25519_batch_prepare(b, 0, m, mlen, pk, RS, num, r, valid);
+	return ret | ed25519_batch_check(b, RS, 0, num, record, valid);
+}
+
+/* r holds the random values for all num signatures, or is NULL to draw them a chunk at a time */
+static int
+ed25519_sign_open_batch_chunked(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, const unsigned char (*r)[16], int *valid) {
+	batch_heap ALIGN(32) batch; /* 32 for the packed 4-way points */
+	ge25519 ALIGN(16) points[heap_batch_size];
+	bignum256modm scalars[heap_batch_size], rs[max_batch_size], hram[max_batch_size];
+	unsigned char keys[max_batch_size][32];
+	size_t key[max_batch_size], slot[max_batch_size], table[max_batch_size * 2];
+	ed25519_batch_terms terms;
+	size_t i, batchsize;
+	int ret = 0;
+
+	terms.points = points;
+	terms.scalars = scalars;
+	terms.rs = rs;
+	terms.hram = hram;
+	terms.pk = keys;
+	terms.key = key;
+	terms.slot = slot;
+	terms.table = table;
+	terms.table_mask = (max_batch_size * 2) - 1;
+	terms.heap = &batch;
+	terms.work_points = NULL;
+	terms.work_scalars = NULL;
+	terms.pippenger = NULL;
+
+	while (num > 3) {
+		batchsize = (num > max_batch_size) ? max_batch_size : num;
+
+		if (!r)
+			ed25519_batch_randombytes(batch.r, batchsize);
+		ret |= ed25519_batch_verify_terms(&terms, m, mlen, pk, RS, batchsize, r ? r : (const unsigned char (*)[16])batch.r, !r, valid);
+
+		if (r)
+			r += batchsize;
 		m += batchsize;
 		mlen += batchsize;
 		pk += batchsize;
@@ -273,3 +630,433 @@ ED25519_FN(ed25519_sign_open_batch) (const unsigned char **m, size_t *mlen, cons
 	return ret;
 }
 
+
+/* the smallest power of 2 table with room for twice num keys */
+static size_t
+ed25519_batch_table_size(size_t num) {
+	size_t size = 1;
+
+	while (size < (num * 2))
+		size *= 2;
+	return size;
+}
+
+/*
+	scratch for ed25519_sign_open_batch_combined: the 2*num + 1 points and
+	scalars, the r*S products and hashes, the 128 bit random values, the keys
+	and their table, a bos-coster heap for the short runs when bisecting, and
+	the terms and scratch for pippenger
+*/
+static size_t
+ed25519_batch_scratch_layout(size_t num, size_t offsets[13]) {
+	size_t terms = (num * 2) + 1;
+
+	offsets[0] = 0;
+	offsets[1] = offsets[0] + multiscalar_align32(terms * sizeof(ge25519));
+	offsets[2] = offsets[1] + multiscalar_align32(terms * sizeof(bignum256modm));
+	offsets[3] = offsets[2] + multiscalar_align32(num * sizeof(bignum256modm));
+	offsets[4] = offsets[3] + multiscalar_align32(num * sizeof(bignum256modm));
+	offsets[5] = offsets[4] + multiscalar_align32(num * 16);
+	offsets[6] = offsets[5] + multiscalar_align32(num * 32);
+	offsets[7] = offsets[6] + multiscalar_align32(num * sizeof(size_t));
+	offsets[8] = offsets[7] + multiscalar_align32(num * sizeof(size_t));
+	offsets[9] = offsets[8] + multiscalar_align32(ed25519_batch_table_size(num) * sizeof(size_t));
+	offsets[10] = offsets[9] + multiscalar_align32(sizeof(batch_heap));
+	offsets[11] = offsets[10] + multiscalar_align32(terms * sizeof(ge25519));
+	offsets[12] = offsets[11] + multiscalar_align32(terms * sizeof(bignum256modm));
+	return offsets[12] + ge25519_multiscalarmult_pippenger_scratch_size(terms) + 31;
+}
+
+/*
+	verify all num signatures as one combination, bisecting it with pippenger
+	while the runs are long. r is as for ed25519_sign_open_batch_chunked
+*/
+static int
+ed25519_sign_open_batch_combined(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, const unsigned char (*r)[16], int *valid, void *scratch) {
+	unsigned char *base = (unsigned char *)(((uintptr_t)scratch + 31) & ~(uintptr_t)31);
+	ed25519_batch_terms terms;
+	size_t offsets[13];
+
+	/* pippenger's terms and scratch for 2*num + 1 terms cover every shorter run */
+	ed25519_batch_scratch_layout(num, offsets);
+	terms.points = (ge25519 *)(base + offsets[0]);
+	terms.scalars = (bignum256modm *)(base + offsets[1]);
+	terms.rs = (bignum256modm *)(base + offsets[2]);
+	terms.hram = (bignum256modm *)(base + offsets[3]);
+	terms.pk = (unsigned char (*)[32])(base + offsets[5]);
+	terms.key = (size_t *)(base + offsets[6]);
+	terms.slot = (size_t *)(base + offsets[7]);
+	terms.table = (size_t *)(base + offsets[8]);
+	terms.table_mask = ed25519_batch_table_size(num) - 1;
+	terms.heap = (batch_heap *)(base + offsets[9]);
+	terms.work_points = (ge25519 *)(base + offsets[10]);
+	terms.work_scalars = (bignum256modm *)(base + offsets[11]);
+	terms.pippenger = base + offsets[12];
+
+	if (r)
+		return ed25519_batch_verify_terms(&terms, m, mlen, pk, RS, num, r, 0, valid);
+	ed25519_batch_randombytes((unsigned char (*)[16])(base + offsets[4]), num);
+	return ed25519_batch_verify_terms(&terms, m, mlen, pk, RS, num, (const unsigned char (*)[16])(base + offsets[4]), 1, valid);
+}
+
+/* bytes of scratch ed25519_sign_open_batch_scratch uses for num signatures, 0 if it needs none */
+size_t
+ED25519_FN(ed25519_sign_open_batch_scratch_size) (size_t num) {
+	size_t offsets[13];
+
+	if (num < ed25519_batch_pippenger_threshold)
+		return 0;
+	return ed25519_batch_scratch_layout(num, offsets);
+}
+
+/* ed25519_sign_open_batch_scratch with the random values r for the num signatures, or NULL to draw them */
+static int
+ed25519_sign_open_batch_random(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, const unsigned char (*r)[16], int *valid, void *scratch, size_t scratch_size) {
+	void *allocated = NULL;
+	size_t needed;
+	int ret;
+
+	if (num < ed25519_batch_pippenger_threshold)
+		return ed25519_sign_open_batch_chunked(m, mlen, pk, RS, num, r, valid);
+
+	needed = ED25519_FN(ed25519_sign_open_batch_scratch_size) (num);
+	if (!scratch || (scratch_size < needed)) {
+		allocated = malloc(needed);
+		if (!allocated)
+			return ed25519_sign_open_batch_chunked(m, mlen, pk, RS, num, r, valid);
+		scratch = allocated;
+	}
+
+	ret = ed25519_sign_open_batch_combined(m, mlen, pk, RS, num, r, valid, scratch);
+
+	free(allocated);
+	return ret;
+}
+
+/*
+	ed25519_sign_open_batch with the scratch for large batches passed in. with
+	scratch NULL or smaller than ed25519_sign_open_batch_scratch_size(num) it
+	is allocated on the heap, and if that fails the batch is verified in
+	chunks instead
+*/
+int
+ED25519_FN(ed25519_sign_open_batch_scratch) (const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, void *scratch, size_t scratch_size) {
+	return ed25519_sign_open_batch_random(m, mlen, pk, RS, num, NULL, valid, scratch, scratch_size);
+}
+
+int
+ED25519_FN(ed25519_sign_open_batch) (const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid) {
+	return ED25519_FN(ed25519_sign_open_batch_scratch) (m, mlen, pk, RS, num, valid, NULL, 0);
+}
+
+
+/*
+	multithreaded batch verification. the signatures are split in to one slice
+	per thread and each slice is verified as a batch of its own, so every
+	thread hashes, decodes and multiplies out its own partial combination. the
+	random values are drawn up front on the calling thread, the generator used
+	for testing is not thread safe
+*/
+
+/* slices are at least this many signatures, fewer are not worth a thread */
+#if !defined(ed25519_batch_mt_min_slice)
+#define ed25519_batch_mt_min_slice max_batch_size
+#endif
+
+typedef struct ed25519_batch_slice_t {
+	const unsigned char **m;
+	size_t *mlen;
+	const unsigned char **pk;
+	const unsigned char **RS;
+	size_t num;
+	const unsigned char (*r)[16];
+	int *valid;
+	int started, ret;
+} ed25519_batch_slice;
+
+static void
+ed25519_batch_slice_verify(ed25519_batch_slice *slice) {
+	slice->ret = ed25519_sign_open_batch_random(slice->m, slice->mlen, slice->pk, slice->RS, slice->num, slice->r, slice->valid, NULL, 0);
+}
+
+#if defined(ED25519_NO_THREADS)
+
+typedef int ed25519_batch_thread;
+
+static int
+ed25519_batch_thread_start(ed25519_batch_thread *thread, ed25519_batch_slice *slice) {
+	(void)thread;
+	(void)slice;
+	return 0;
+}
+
+static void
+ed25519_batch_thread_join(ed25519_batch_thread thread) {
+	(void)thread;
+}
+
+#elif defined(OS_WINDOWS)
+
+#include <windows.h>
+
+typedef HANDLE ed25519_batch_thread;
+
+static DWORD WINAPI
+ed25519_batch_thread_main(LPVOID slice) {
+	ed25519_batch_slice_verify((ed25519_batch_slice *)slice);
+	return 0;
+}
+
+static int
+ed25519_batch_thread_start(ed25519_batch_thread *thread, ed25519_batch_slice *slice) {
+	*thread = CreateThread(NULL, 0, ed25519_batch_thread_main, slice, 0, NULL);
+	return (*thread != NULL);
+}
+
+static void
+ed25519_batch_thread_join(ed25519_batch_thread thread) {
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+#else
+
+#include <pthread.h>
+
+typedef pthread_t ed25519_batch_thread;
+
+static void *
+ed25519_batch_thread_main(void *slice) {
+	ed25519_batch_slice_verify((ed25519_batch_slice *)slice);
+	return NULL;
+}
+
+static int
+ed25519_batch_thread_start(ed25519_batch_thread *thread, ed25519_batch_slice *slice) {
+	return (pthread_create(thread, NULL, ed25519_batch_thread_main, slice) == 0);
+}
+
+static void
+ed25519_batch_thread_join(ed25519_batch_thread thread) {
+	pthread_join(thread, NULL);
+}
+
+#endif
+
+/*
+	ed25519_sign_open_batch on up to nthreads threads, the calling thread
+	included. slices whose thread can not be started, or everything if memory
+	can not be allocated, are verified on the calling thread
+*/
+int
+ED25519_FN(ed25519_sign_open_batch_mt) (const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, size_t nthreads) {
+	ed25519_batch_slice *slices;
+	ed25519_batch_thread *threads;
+	unsigned char (*r)[16];
+	size_t i, offset;
+	int ret = 0;
+
+	if (nthreads > (num / ed25519_batch_mt_min_slice))
+		nthreads = num / ed25519_batch_mt_min_slice;
+	if (nthreads < 2)
+		return ED25519_FN(ed25519_sign_open_batch) (m, mlen, pk, RS, num, valid);
+
+	slices = (ed25519_batch_slice *)malloc(nthreads * sizeof(ed25519_batch_slice));
+	threads = (ed25519_batch_thread *)malloc(nthreads * sizeof(ed25519_batch_thread));
+	r = (unsigned char (*)[16])malloc(num * 16);
+	if (!slices || !threads || !r) {
+		free(slices);
+		free(threads);
+		free(r);
+		return ED25519_FN(ed25519_sign_open_batch) (m, mlen, pk, RS, num, valid);
+	}
+
+	ed25519_batch_randombytes(r, num);
+	for (i = 0, offset = 0; i < nthreads; i++) {
+		slices[i].num = (num / nthreads) + ((i < (num % nthreads)) ? 1 : 0);
+		slices[i].m = m + offset;
+		slices[i].mlen = mlen + offset;
+		slices[i].pk = pk + offset;
+		slices[i].RS = RS + offset;
+		slices[i].r = (const unsigned char (*)[16])(r + offset);
+		slices[i].valid = valid + offset;
+		offset += slices[i].num;
+	}
+
+	/* the calling thread takes the first slice */
+	for (i = 1; i < nthreads; i++)
+		slices[i].started = ed25519_batch_thread_start(&threads[i], &slices[i]);
+	ed25519_batch_slice_verify(&slices[0]);
+
+	for (i = 1; i < nthreads; i++) {
+		if (slices[i].started)
+			ed25519_batch_thread_join(threads[i]);
+		else
+			ed25519_batch_slice_verify(&slices[i]);
+	}
+
+	for (i = 0; i < nthreads; i++)
+		ret |= slices[i].ret;
+
+	free(slices);
+	free(threads);
+	free(r);
+	return ret;
+}
+
+
+/*
+	streaming batch verification. every signature is hashed, expanded and
+	decoded as it is added, which leaves the multiscalar multiplication for
+	ed25519_batch_finalize. the messages are not kept: the terms and a copy of
+	the signature are enough to verify one on its own when bisecting
+*/
+struct ed25519_batch_t {
+	void *block; /* the regions of ed25519_batch_stream_layout, doubled when full */
+	size_t num, capacity;
+	ed25519_batch_terms terms;
+	unsigned char (*sigs)[64];
+	const unsigned char **RS;
+	int *valid;
+	int ret;
+};
+
+/*
+	the terms and keys for capacity signatures, copies of the signatures,
+	pointers to them, valid and the table of the keys. offsets[11] is the end
+*/
+static size_t
+ed25519_batch_stream_layout(size_t capacity, size_t offsets[12]) {
+	size_t terms = (capacity * 2) + 1;
+
+	offsets[0] = 0;
+	offsets[1] = offsets[0] + multiscalar_align32(terms * sizeof(ge25519));
+	offsets[2] = offsets[1] + multiscalar_align32(terms * sizeof(bignum256modm));
+	offsets[3] = offsets[2] + multiscalar_align32(capacity * sizeof(bignum256modm));
+	offsets[4] = offsets[3] + multiscalar_align32(capacity * sizeof(bignum256modm));
+	offsets[5] = offsets[4] + multiscalar_align32(capacity * 32);
+	offsets[6] = offsets[5] + multiscalar_align32(capacity * sizeof(size_t));
+	offsets[7] = offsets[6] + multiscalar_align32(capacity * sizeof(size_t));
+	offsets[8] = offsets[7] + multiscalar_align32(capacity * 64);
+	offsets[9] = offsets[8] + multiscalar_align32(capacity * sizeof(const unsigned char *));
+	offsets[10] = offsets[9] + multiscalar_align32(capacity * sizeof(int));
+	offsets[11] = offsets[10] + multiscalar_align32(ed25519_batch_table_size(capacity) * sizeof(size_t));
+	return offsets[11] + 31;
+}
+
+static int
+ed25519_batch_stream_reserve(ed25519_batch *ctx, size_t capacity) {
+	size_t offsets[12], old_offsets[12], i;
+	unsigned char *block, *base, *old_base;
+
+	block = (unsigned char *)malloc(ed25519_batch_stream_layout(capacity, offsets));
+	if (!block)
+		return 0;
+	base = (unsigned char *)(((uintptr_t)block + 31) & ~(uintptr_t)31);
+
+	/* the regions only grow, so each old one fits at the start of the new one. the table is rebuilt */
+	if (ctx->block) {
+		old_base = (unsigned char *)(((uintptr_t)ctx->block + 31) & ~(uintptr_t)31);
+		ed25519_batch_stream_layout(ctx->capacity, old_offsets);
+		for (i = 0; i < 10; i++)
+			memcpy(base + offsets[i], old_base + old_offsets[i], old_offsets[i + 1] - old_offsets[i]);
+		free(ctx->block);
+	}
+
+	ctx->block = block;
+	ctx->capacity = capacity;
+	ctx->terms.points = (ge25519 *)(base + offsets[0]);
+	ctx->terms.scalars = (bignum256modm *)(base + offsets[1]);
+	ctx->terms.rs = (bignum256modm *)(base + offsets[2]);
+	ctx->terms.hram = (bignum256modm *)(base + offsets[3]);
+	ctx->terms.pk = (unsigned char (*)[32])(base + offsets[4]);
+	ctx->terms.key = (size_t *)(base + offsets[5]);
+	ctx->terms.slot = (size_t *)(base + offsets[6]);
+	ctx->sigs = (unsigned char (*)[64])(base + offsets[7]);
+	ctx->RS = (const unsigned char **)(base + offsets[8]);
+	ctx->valid = (int *)(base + offsets[9]);
+	ctx->terms.table = (size_t *)(base + offsets[10]);
+	ctx->terms.table_mask = ed25519_batch_table_size(capacity) - 1;
+
+	memset(ctx->terms.table, 0, (ctx->terms.table_mask + 1) * sizeof(size_t));
+	for (i = 0; i < ctx->num; i++) {
+		if (ctx->terms.key[i] == i)
+			ctx->terms.table[ed25519_batch_key_find(&ctx->terms, ctx->terms.pk[i])] = i + 1;
+	}
+	return 1;
+}
+
+/* a new streaming batch, NULL if there is no memory for it */
+ed25519_batch *
+ED25519_FN(ed25519_batch_init) (void) {
+	ed25519_batch *ctx = (ed25519_batch *)malloc(sizeof(ed25519_batch));
+
+	if (!ctx)
+		return NULL;
+	memset(ctx, 0, sizeof(ed25519_batch));
+	if (!ed25519_batch_stream_reserve(ctx, max_batch_size)) {
+		free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/* 0 if the signature was added, -1 if there was no memory for it */
+int
+ED25519_FN(ed25519_batch_add) (ed25519_batch *ctx, const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS) {
+	unsigned char r[1][16];
+	size_t i = ctx->num;
+
+	if ((i == ctx->capacity) && !ed25519_batch_stream_reserve(ctx, ctx->capacity * 2))
+		return -1;
+
+	ed25519_batch_randombytes(r, 1);
+	ctx->ret |= ed25519_batch_prepare(&ctx->terms, i, &m, &mlen, &pk, &RS, 1, (const unsigned char (*)[16])r, ctx->valid);
+	memcpy(ctx->sigs[i], RS, 64);
+	ctx->num++;
+	return 0;
+}
+
+/*
+	verify everything added to ctx and free it. valid[] is set in the order the
+	signatures were added, and the return value is that of ed25519_sign_open_batch.
+	without the memory for pippenger it falls back to bos-coster in chunks
+*/
+int
+ED25519_FN(ed25519_batch_finalize) (ed25519_batch *ctx, int *valid) {
+	batch_heap ALIGN(32) batch; /* 32 for the packed 4-way points */
+	unsigned char *pippenger = NULL, *base;
+	size_t i, num = ctx->num, terms = (num * 2) + 1, batchsize, offsets[2];
+	int ret = ctx->ret;
+
+	for (i = 0; i < num; i++)
+		ctx->RS[i] = ctx->sigs[i];
+
+	ctx->terms.heap = &batch;
+	ctx->terms.work_points = NULL;
+	ctx->terms.work_scalars = NULL;
+	ctx->terms.pippenger = NULL;
+	if (num > max_batch_size) {
+		offsets[0] = multiscalar_align32(terms * sizeof(ge25519));
+		offsets[1] = offsets[0] + multiscalar_align32(terms * sizeof(bignum256modm));
+		pippenger = (unsigned char *)malloc(offsets[1] + ge25519_multiscalarmult_pippenger_scratch_size(terms) + 31);
+		if (pippenger) {
+			base = (unsigned char *)(((uintptr_t)pippenger + 31) & ~(uintptr_t)31);
+			ctx->terms.work_points = (ge25519 *)base;
+			ctx->terms.work_scalars = (bignum256modm *)(base + offsets[0]);
+			ctx->terms.pippenger = base + offsets[1];
+		}
+	}
+
+	for (i = 0; (num - i) > 3; i += batchsize) {
+		batchsize = (ctx->terms.pippenger || ((num - i) <= max_batch_size)) ? (num - i) : max_batch_size;
+		ret |= ed25519_batch_check(&ctx->terms, ctx->RS, i, batchsize, 1, ctx->valid);
+	}
+	ret |= ed25519_batch_verify_each(&ctx->terms, ctx->RS, i, num - i, ctx->valid);
+
+	memcpy(valid, ctx->valid, num * sizeof(int));
+	free(pippenger);
+	free(ctx->block);
+	free(ctx);
+	return ret;
+}
@@ -217,6 +217,28 @@ ge25519_pack(unsigned char r[32], const ge25519 *p) {
 	r[31] ^= ((parity[0] & 1) << 7);
 }
 
+/*
+	pack n points with a single inversion, zs and zis are scratch space for n
+	elements each
+*/
+static void
+ge25519_pack_batch(unsigned char (*r)[32], const ge25519 *p, size_t n, bignum25519 *zs, bignum25519 *zis) {
+	bignum25519 ALIGN(16) tx, ty;
+	unsigned char parity[32];
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		curve25519_copy(zs[i], p[i].z);
+	curve25519_batch_recip(zis, zs, n);
+	for (i = 0; i < n; i++) {
+		curve25519_mul(tx, p[i].x, zis[i]);
+		curve25519_mul(ty, p[i].y, zis[i]);
+		curve25519_contract(r[i], ty);
+		curve25519_contract(parity, tx);
+		r[i][31] ^= ((parity[0] & 1) << 7);
+	}
+}
+
 
 static int
 ge25519_unpack_negative_vartime(ge25519 *r, const unsigned char p[32]) {
@@ -318,7 +340,11 @@ ge25519_double_scalarmult_vartime(ge25519 *r, const ge25519 *p1, const bignum256
 			ge25519_nielsadd2_p1p1(&t, r, &ge25519_niels_sliding_multiples[abs(slide2[i]) / 2], (unsigned char)slide2[i] >> 7);
 		}
 
-		ge25519_p1p1_to_partial(r, &t);
+		/* the caller may go on to add to r, so finish with t */
+		if (i > 0)
+			ge25519_p1p1_to_partial(r, &t);
+		else
+			ge25519_p1p1_to_full(r, &t);
 	}
 }
 
@@ -0,0 +1,191 @@
+/*
+	4-way point arithmetic, one point at a time with X, Y, Z and T in the
+	four lanes of a bignum25519x4, using the parallel extended coordinate
+	formulas of Hisil, Wong, Carter and Dawson, "Twisted Edwards Curves
+	Revisited", section 4.
+
+	The field arithmetic comes from curve25519-donna-ifma.h.
+
+	Additions and doublings produce exactly the same projective coordinates
+	as ge25519_add and ge25519_double, only the order of the multiplications
+	differs.
+*/
+
+/* X, Y, Z, T */
+typedef struct ge25519x4_t {
+	bignum25519x4 v;
+} ge25519x4;
+
+/* Y-X, Y+X, 2Z, 2dT */
+typedef struct ge25519x4_cached_t {
+	bignum25519x4 v;
+} ge25519x4_cached;
+
+/* (1, 1, 2, 2d) */
+static const packedelem64x4 ALIGN(32) ge25519x4_cached_scale[5] = {
+	{{0x0000000000001, 0x0000000000001, 0x0000000000002, 0x69b9426b2f159}},
+	{{0x0000000000000, 0x0000000000000, 0x0000000000000, 0x35050762add7a}},
+	{{0x0000000000000, 0x0000000000000, 0x0000000000000, 0x3cf44c0038052}},
+	{{0x0000000000000, 0x0000000000000, 0x0000000000000, 0x6738cc7407977}},
+	{{0x0000000000000, 0x0000000000000, 0x0000000000000, 0x2406d9dc56dff}}
+};
+
+static const bignum25519 ge25519x4_two = {2, 0, 0, 0, 0};
+
+/*
+	conversions
+*/
+
+CURVE25519X4_FN static void
+ge25519x4_pack(ge25519x4 *r, const ge25519 *p) {
+	curve25519x4_pack(r->v, p->x, p->y, p->z, p->t);
+}
+
+CURVE25519X4_FN static void
+ge25519x4_unpack(ge25519 *r, const ge25519x4 *p) {
+	curve25519x4_unpack(r->x, r->y, r->z, r->t, p->v);
+}
+
+DONNA_INLINE CURVE25519X4_FN static void
+ge25519x4_set_neutral(ge25519x4 *r) {
+	curve25519x4_zero(r->v);
+	r->v[0] = _mm256_set_epi64x(0, 1, 1, 0);
+}
+
+CURVE25519X4_FN static void
+ge25519x4_to_cached(ge25519x4_cached *r, const ge25519x4 *p) {
+	bignum25519x4 t;
+
+	/* (Y-X, Y+X, Z, T) */
+	curve25519x4_diff_sum(t, p->v);
+	curve25519x4_blend_CD(t, t, p->v);
+	curve25519x4_mul(r->v, t, (const ymmi *)ge25519x4_cached_scale);
+}
+
+/* affine niels points have z = 1 and already carry 2dT */
+CURVE25519X4_FN static void
+ge25519x4_niels_to_cached(ge25519x4_cached *r, const ge25519_niels *q) {
+	curve25519x4_pack(r->v, q->ysubx, q->xaddy, ge25519x4_two, q->t2d);
+}
+
+/* (Y+X, Y-X, 2Z, -2dT) */
+CURVE25519X4_FN static void
+ge25519x4_cached_neg(ge25519x4_cached *r, const ge25519x4_cached *q) {
+	bignum25519x4 neg;
+
+	curve25519x4_neg(neg, q->v);
+	curve25519x4_blend_D(neg, q->v, neg);
+	curve25519x4_permute(r->v, neg, &packed4_BACD);
+}
+
+/*
+	adding & doubling
+*/
+
+CURVE25519X4_FN static void
+ge25519x4_add(ge25519x4 *r, const ge25519x4 *p, const ge25519x4_cached *q) {
+	bignum25519x4 t, t0, t1;
+
+	/* (Y1-X1, Y1+X1, Z1, T1) * (Y2-X2, Y2+X2, 2Z2, 2dT2) = (A, B, D, C) */
+	curve25519x4_diff_sum(t, p->v);
+	curve25519x4_blend_CD(t, t, p->v);
+	curve25519x4_mul(t, t, q->v);
+
+	/* (E, H, F, G) = (B-A, B+A, D-C, D+C) */
+	curve25519x4_permute(t, t, &packed4_ABDC);
+	curve25519x4_diff_sum(t, t);
+
+	/* (E, G, G, E) * (F, H, F, H) = (X3, Y3, Z3, T3) */
+	curve25519x4_permute(t0, t, &packed4_ADDA);
+	curve25519x4_permute(t1, t, &packed4_CBCB);
+	curve25519x4_mul(r->v, t0, t1);
+}
+
+/* r = p + q for signbit = 0, p - q for signbit = 1 */
+CURVE25519X4_FN static void
+ge25519x4_add_signed(ge25519x4 *r, const ge25519x4 *p, const ge25519x4_cached *q, unsigned char signbit) {
+	ge25519x4_cached neg;
+
+	if (signbit) {
+		ge25519x4_cached_neg(&neg, q);
+		q = &neg;
+	}
+	ge25519x4_add(r, p, q);
+}
+
+CURVE25519X4_FN static void
+ge25519x4_double(ge25519x4 *r, const ge25519x4 *p) {
+	bignum25519x4 t, s1, s2, sum, u, v;
+
+	/* (X^2, Y^2, Z^2, (X+Y)^2) = (S1, S2, S3, S4) */
+	curve25519x4_permute(t, p->v, &packed4_ABCA);
+	curve25519x4_permute(u, p->v, &packed4_BBBB);
+	curve25519x4_add_reduce(u, t, u);
+	curve25519x4_blend_D(t, t, u);
+	curve25519x4_square(t, t);
+
+	/* (S1+S2, S2-S1, 2*S3+S1-S2, S4-S1-S2) */
+	curve25519x4_permute(s1, t, &packed4_AAAA);
+	curve25519x4_permute(s2, t, &packed4_BBBB);
+	curve25519x4_add(sum, s1, s2);
+	curve25519x4_sub(u, s2, s1);
+	curve25519x4_blend_B(u, sum, u);
+	curve25519x4_sub(s1, s1, s2);
+	curve25519x4_add(s1, s1, t);
+	curve25519x4_add(s1, s1, t);
+	curve25519x4_sub_after_basic(v, t, sum);
+	curve25519x4_blend_D(v, s1, v);
+	curve25519x4_blend_CD(u, u, v);
+	curve25519x4_carry(u);
+
+	/* (2*S3+S1-S2, S1+S2, 2*S3+S1-S2, S1+S2) * (S4-S1-S2, S2-S1, S2-S1, S4-S1-S2) */
+	curve25519x4_permute(t, u, &packed4_CACA);
+	curve25519x4_permute(v, u, &packed4_DBBD);
+	curve25519x4_mul(r->v, t, v);
+}
+
+
+/*
+	scalarmults
+*/
+
+/* computes [s1]p1 + [s2]basepoint, ge25519_double_scalarmult_vartime calls this when curve25519x4_available() */
+CURVE25519X4_FN static void
+ge25519_double_scalarmult_vartime_x4(ge25519 *r, const ge25519 *p1, const bignum256modm s1, const bignum256modm s2) {
+	signed char slide1[256], slide2[256];
+	ge25519x4_cached pre1[S1_TABLE_SIZE], q;
+	ge25519x4 a, d1;
+	int32_t i;
+
+	contract256_slidingwindow_modm(slide1, s1, S1_SWINDOWSIZE);
+	contract256_slidingwindow_modm(slide2, s2, S2_SWINDOWSIZE);
+
+	ge25519x4_pack(&a, p1);
+	ge25519x4_to_cached(&pre1[0], &a);
+	ge25519x4_double(&d1, &a);
+	ge25519x4_to_cached(&q, &d1);
+	for (i = 0; i < S1_TABLE_SIZE - 1; i++) {
+		ge25519x4_add(&a, &a, &q);
+		ge25519x4_to_cached(&pre1[i+1], &a);
+	}
+
+	ge25519x4_set_neutral(&a);
+
+	i = 255;
+	while ((i >= 0) && !(slide1[i] | slide2[i]))
+		i--;
+
+	for (; i >= 0; i--) {
+		ge25519x4_double(&a, &a);
+
+		if (slide1[i])
+			ge25519x4_add_signed(&a, &a, &pre1[abs(slide1[i]) / 2], (unsigned char)slide1[i] >> 7);
+
+		if (slide2[i]) {
+			ge25519x4_niels_to_cached(&q, &ge25519_niels_sliding_multiples[abs(slide2[i]) / 2]);
+			ge25519x4_add_signed(&a, &a, &q, (unsigned char)slide2[i] >> 7);
+		}
+	}
+
+	ge25519x4_unpack(r, &a);
+}
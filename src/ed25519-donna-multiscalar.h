@@ -0,0 +1,429 @@
+/*
+	Variable time multiscalar multiplication, [s1]p1 + [s2]p2 + ... + [sn]pn
+
+	Straus' method (interleaved sliding windows) is used for small n, and
+	Pippenger's bucket method with signed digits, over points normalized to
+	affine niels form, for large n. Neither has an upper bound on n, all
+	scratch space is allocated on the heap, or for Pippenger optionally
+	passed in by the caller.
+
+	Scalars must be reduced mod the group order, e.g. from expand256_modm.
+*/
+
+/* below this many terms Straus is faster than Pippenger */
+#if !defined(multiscalar_pippenger_threshold)
+#define multiscalar_pippenger_threshold 128
+#endif
+
+#define multiscalar_pippenger_min_window 4
+#define multiscalar_pippenger_max_window 16
+
+/*
+	recode s into count signed radix 2^w digits in [-2^(w-1), 2^(w-1)),
+	count * w must be at least 256
+*/
+static void
+contract256_signed_radix_modm(int16_t *digits, size_t stride, size_t count, const bignum256modm s, size_t w) {
+	unsigned char bytes[32 + 3] = {0};
+	const uint32_t mask = ((uint32_t)1 << w) - 1, half = (uint32_t)1 << (w - 1);
+	uint32_t v, carry = 0;
+	size_t i, bit;
+
+	contract256_modm(bytes, s);
+
+	for (i = 0, bit = 0; i < count; i++, bit += w) {
+		v = ((uint32_t)bytes[(bit / 8) + 0]      ) |
+		    ((uint32_t)bytes[(bit / 8) + 1] <<  8) |
+		    ((uint32_t)bytes[(bit / 8) + 2] << 16);
+		v = ((v >> (bit % 8)) & mask) + carry;
+		carry = (v + half) >> w;
+		digits[i * stride] = (int16_t)((int32_t)v - (int32_t)(carry << w));
+	}
+}
+
+/* pick the window which minimises the number of additions, (256/w) * (n + 2^w) */
+static size_t
+ge25519_multiscalarmult_pippenger_window(size_t n) {
+	size_t w, cost, best_w = multiscalar_pippenger_min_window, best_cost = (size_t)-1;
+
+	for (w = multiscalar_pippenger_min_window; w <= multiscalar_pippenger_max_window; w++) {
+		cost = ((256 + w - 1) / w) * (n + ((size_t)1 << w));
+		if (cost < best_cost) {
+			best_cost = cost;
+			best_w = w;
+		}
+	}
+	return best_w;
+}
+
+/*
+	convert n points to affine niels form with a single inversion, zs and zis are
+	scratch space for n elements each
+*/
+static void
+ge25519_full_to_niels_batch(ge25519_niels *r, const ge25519 *p, size_t n, bignum25519 *zs, bignum25519 *zis) {
+	bignum25519 ALIGN(16) x, y;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		curve25519_copy(zs[i], p[i].z);
+	curve25519_batch_recip(zis, zs, n);
+	for (i = 0; i < n; i++) {
+		curve25519_mul(x, p[i].x, zis[i]);
+		curve25519_mul(y, p[i].y, zis[i]);
+		curve25519_sub_reduce(r[i].ysubx, y, x);
+		curve25519_add_reduce(r[i].xaddy, y, x);
+		curve25519_mul(r[i].t2d, x, y);
+		curve25519_mul(r[i].t2d, r[i].t2d, ge25519_ec2d);
+	}
+}
+
+/*
+	pippenger keeps the signed digits, one precomputed point per term, the
+	buckets and, for the affine normalization, two field elements per term in
+	one block. every part is 32 byte aligned for the 4-way points, and the
+	block itself may start anywhere, so the size includes the slack to align
+	it. precomputed points and buckets are sized by the caller
+*/
+#define multiscalar_align32(x) (((x) + 31) & ~(size_t)31)
+
+static size_t
+ge25519_multiscalarmult_pippenger_scratch_layout(size_t n, size_t pre_size, size_t zs_count, size_t bucket_size, size_t offsets[4]) {
+	size_t w = ge25519_multiscalarmult_pippenger_window(n), columns = (256 + w - 1) / w, nbuckets = (size_t)1 << (w - 1);
+
+	offsets[0] = 0;
+	offsets[1] = offsets[0] + multiscalar_align32(n * columns * sizeof(int16_t));
+	offsets[2] = offsets[1] + multiscalar_align32(n * pre_size);
+	offsets[3] = offsets[2] + multiscalar_align32(zs_count * sizeof(bignum25519));
+	return offsets[3] + multiscalar_align32(nbuckets * bucket_size) + 31;
+}
+
+/* split scratch in to the parts laid out above, zs may be NULL if it is not needed */
+static void
+ge25519_multiscalarmult_pippenger_scratch(void *scratch, size_t n, void **digits, void **pre, size_t pre_size, void **zs, void **buckets, size_t bucket_size) {
+	unsigned char *base = (unsigned char *)(((uintptr_t)scratch + 31) & ~(uintptr_t)31);
+	size_t offsets[4];
+
+	ge25519_multiscalarmult_pippenger_scratch_layout(n, pre_size, zs ? 2 * n : 0, bucket_size, offsets);
+	*digits = base + offsets[0];
+	*pre = base + offsets[1];
+	if (zs)
+		*zs = base + offsets[2];
+	*buckets = base + offsets[3];
+}
+
+#if defined(ED25519_X4)
+
+/*
+	4-way versions of both methods on ge25519x4, which needs 32 byte aligned
+	scratch space. cached points cost the same to add whether z is 1 or not, so
+	pippenger skips the affine normalization. the portable versions below call
+	these when curve25519x4_available()
+*/
+
+/* ge25519_multiscalarmult_straus_vartime on ge25519x4 */
+CURVE25519X4_FN static int
+ge25519_multiscalarmult_straus_vartime_x4(ge25519 *r, const ge25519 *points, const bignum256modm *scalars, size_t n) {
+	signed char *slides;
+	ge25519x4_cached *pre, d;
+	ge25519x4 a, p;
+	size_t j, k;
+	int32_t i;
+
+	/* set neutral */
+	memset(r, 0, sizeof(ge25519));
+	r->y[0] = 1;
+	r->z[0] = 1;
+
+	if (!n)
+		return 1;
+
+	slides = (signed char *)malloc(n * 256);
+	pre = (ge25519x4_cached *)_mm_malloc(n * S1_TABLE_SIZE * sizeof(ge25519x4_cached), 32);
+	if (!slides || !pre) {
+		free(slides);
+		if (pre)
+			_mm_free(pre);
+		return 0;
+	}
+
+	/* odd multiples [1]p, [3]p, .. [2*S1_TABLE_SIZE-1]p for each point */
+	for (j = 0; j < n; j++) {
+		contract256_slidingwindow_modm(&slides[j * 256], scalars[j], S1_SWINDOWSIZE);
+		ge25519x4_pack(&p, &points[j]);
+		ge25519x4_to_cached(&pre[j * S1_TABLE_SIZE], &p);
+		ge25519x4_double(&a, &p);
+		ge25519x4_to_cached(&d, &a);
+		for (k = 0; k < S1_TABLE_SIZE - 1; k++) {
+			ge25519x4_add(&p, &p, &d);
+			ge25519x4_to_cached(&pre[(j * S1_TABLE_SIZE) + k + 1], &p);
+		}
+	}
+
+	for (i = 255; i >= 0; i--) {
+		for (j = 0; j < n; j++)
+			if (slides[(j * 256) + i])
+				break;
+		if (j < n)
+			break;
+	}
+
+	ge25519x4_set_neutral(&a);
+	for (; i >= 0; i--) {
+		ge25519x4_double(&a, &a);
+
+		for (j = 0; j < n; j++) {
+			signed char slide = slides[(j * 256) + i];
+			if (slide)
+				ge25519x4_add_signed(&a, &a, &pre[(j * S1_TABLE_SIZE) + (abs(slide) / 2)], (unsigned char)slide >> 7);
+		}
+	}
+	ge25519x4_unpack(r, &a);
+
+	free(slides);
+	_mm_free(pre);
+	return 1;
+}
+
+/* ge25519_multiscalarmult_pippenger_vartime on ge25519x4, scratch is laid out by ge25519_multiscalarmult_pippenger_scratch */
+CURVE25519X4_FN static void
+ge25519_multiscalarmult_pippenger_vartime_x4(ge25519 *r, const ge25519 *points, const bignum256modm *scalars, size_t n, void *scratch) {
+	size_t w, columns, nbuckets, c, i, j;
+	int16_t *digits;
+	ge25519x4_cached *pre, t;
+	ge25519x4 *buckets;
+	ge25519x4 acc, running, sum, p;
+
+	/* set neutral */
+	memset(r, 0, sizeof(ge25519));
+	r->y[0] = 1;
+	r->z[0] = 1;
+
+	if (!n)
+		return;
+
+	w = ge25519_multiscalarmult_pippenger_window(n);
+	columns = (256 + w - 1) / w;
+	nbuckets = (size_t)1 << (w - 1);
+
+	/* digits are stored column-major so each pass walks them linearly */
+	ge25519_multiscalarmult_pippenger_scratch(scratch, n, (void **)&digits, (void **)&pre, sizeof(ge25519x4_cached), NULL, (void **)&buckets, sizeof(ge25519x4));
+
+	for (i = 0; i < n; i++) {
+		contract256_signed_radix_modm(&digits[i], n, columns, scalars[i], w);
+		ge25519x4_pack(&p, &points[i]);
+		ge25519x4_to_cached(&pre[i], &p);
+	}
+
+	ge25519x4_set_neutral(&acc);
+	for (c = columns; c-- > 0;) {
+		/* acc = [2^w]acc */
+		if (c != columns - 1) {
+			for (j = 0; j < w; j++)
+				ge25519x4_double(&acc, &acc);
+		}
+
+		for (j = 0; j < nbuckets; j++)
+			ge25519x4_set_neutral(&buckets[j]);
+
+		/* bucket[|d|-1] += sign(d)p */
+		for (i = 0; i < n; i++) {
+			int16_t digit = digits[(c * n) + i];
+			if (digit > 0)
+				ge25519x4_add(&buckets[digit - 1], &buckets[digit - 1], &pre[i]);
+			else if (digit < 0)
+				ge25519x4_add_signed(&buckets[-digit - 1], &buckets[-digit - 1], &pre[i], 1);
+		}
+
+		/* sum = 1*bucket[0] + 2*bucket[1] + ... with a running sum from the top */
+		running = buckets[nbuckets - 1];
+		sum = running;
+		for (j = nbuckets - 1; j-- > 0;) {
+			ge25519x4_to_cached(&t, &buckets[j]);
+			ge25519x4_add(&running, &running, &t);
+			ge25519x4_to_cached(&t, &running);
+			ge25519x4_add(&sum, &sum, &t);
+		}
+
+		ge25519x4_to_cached(&t, &sum);
+		ge25519x4_add(&acc, &acc, &t);
+	}
+	ge25519x4_unpack(r, &acc);
+}
+
+#endif /* ED25519_X4 */
+
+/* computes [s1]p1 + ... + [sn]pn with interleaved sliding windows, returns 0 if out of memory */
+static int
+ge25519_multiscalarmult_straus_vartime(ge25519 *r, const ge25519 *points, const bignum256modm *scalars, size_t n) {
+	signed char *slides;
+	ge25519_pniels *pre;
+	ge25519 ALIGN(16) d;
+	ge25519_p1p1 ALIGN(16) t;
+	size_t j, k;
+	int32_t i;
+
+#if defined(ED25519_X4)
+	if (curve25519x4_available())
+		return ge25519_multiscalarmult_straus_vartime_x4(r, points, scalars, n);
+#endif
+
+	/* set neutral */
+	memset(r, 0, sizeof(ge25519));
+	r->y[0] = 1;
+	r->z[0] = 1;
+
+	if (!n)
+		return 1;
+
+	slides = (signed char *)malloc(n * 256);
+	pre = (ge25519_pniels *)malloc(n * S1_TABLE_SIZE * sizeof(ge25519_pniels));
+	if (!slides || !pre) {
+		free(slides);
+		free(pre);
+		return 0;
+	}
+
+	/* odd multiples [1]p, [3]p, .. [2*S1_TABLE_SIZE-1]p for each point */
+	for (j = 0; j < n; j++) {
+		contract256_slidingwindow_modm(&slides[j * 256], scalars[j], S1_SWINDOWSIZE);
+		ge25519_double(&d, &points[j]);
+		ge25519_full_to_pniels(&pre[j * S1_TABLE_SIZE], &points[j]);
+		for (k = 0; k < S1_TABLE_SIZE - 1; k++)
+			ge25519_pnielsadd(&pre[(j * S1_TABLE_SIZE) + k + 1], &d, &pre[(j * S1_TABLE_SIZE) + k]);
+	}
+
+	for (i = 255; i >= 0; i--) {
+		for (j = 0; j < n; j++)
+			if (slides[(j * 256) + i])
+				break;
+		if (j < n)
+			break;
+	}
+
+	for (; i >= 0; i--) {
+		ge25519_double_p1p1(&t, r);
+
+		for (j = 0; j < n; j++) {
+			signed char slide = slides[(j * 256) + i];
+			if (slide) {
+				ge25519_p1p1_to_full(r, &t);
+				ge25519_pnielsadd_p1p1(&t, r, &pre[(j * S1_TABLE_SIZE) + (abs(slide) / 2)], (unsigned char)slide >> 7);
+			}
+		}
+
+		if (i > 0)
+			ge25519_p1p1_to_partial(r, &t);
+		else
+			ge25519_p1p1_to_full(r, &t);
+	}
+
+	free(slides);
+	free(pre);
+	return 1;
+}
+
+/* bytes of scratch ge25519_multiscalarmult_pippenger_vartime_scratch needs for n terms */
+static size_t
+ge25519_multiscalarmult_pippenger_scratch_size(size_t n) {
+	size_t offsets[4];
+
+#if defined(ED25519_X4)
+	if (curve25519x4_available())
+		return ge25519_multiscalarmult_pippenger_scratch_layout(n, sizeof(ge25519x4_cached), 0, sizeof(ge25519x4), offsets);
+#endif
+	return ge25519_multiscalarmult_pippenger_scratch_layout(n, sizeof(ge25519_niels), 2 * n, sizeof(ge25519), offsets);
+}
+
+/*
+	computes [s1]p1 + ... + [sn]pn with the signed digit bucket method, in
+	ge25519_multiscalarmult_pippenger_scratch_size(n) bytes of scratch
+*/
+static void
+ge25519_multiscalarmult_pippenger_vartime_scratch(ge25519 *r, const ge25519 *points, const bignum256modm *scalars, size_t n, void *scratch) {
+	size_t w, columns, nbuckets, c, i, j;
+	int16_t *digits;
+	ge25519_niels *pre;
+	bignum25519 *zs;
+	ge25519 *buckets;
+	ge25519 ALIGN(16) running, sum;
+	ge25519_p1p1 ALIGN(16) t;
+
+#if defined(ED25519_X4)
+	if (curve25519x4_available()) {
+		ge25519_multiscalarmult_pippenger_vartime_x4(r, points, scalars, n, scratch);
+		return;
+	}
+#endif
+
+	/* set neutral */
+	memset(r, 0, sizeof(ge25519));
+	r->y[0] = 1;
+	r->z[0] = 1;
+
+	if (!n)
+		return;
+
+	w = ge25519_multiscalarmult_pippenger_window(n);
+	columns = (256 + w - 1) / w;
+	nbuckets = (size_t)1 << (w - 1);
+
+	/* digits are stored column-major so each pass walks them linearly */
+	ge25519_multiscalarmult_pippenger_scratch(scratch, n, (void **)&digits, (void **)&pre, sizeof(ge25519_niels), (void **)&zs, (void **)&buckets, sizeof(ge25519));
+
+	for (i = 0; i < n; i++)
+		contract256_signed_radix_modm(&digits[i], n, columns, scalars[i], w);
+
+	/* each point is added 256/w times, so normalizing them once to affine niels form
+	   lets every bucket addition skip the multiplication by z */
+	ge25519_full_to_niels_batch(pre, points, n, zs, zs + n);
+
+	for (c = columns; c-- > 0;) {
+		/* r = [2^w]r */
+		if (c != columns - 1) {
+			for (j = 0; j < w - 1; j++)
+				ge25519_double_partial(r, r);
+			ge25519_double(r, r);
+		}
+
+		for (j = 0; j < nbuckets; j++) {
+			memset(&buckets[j], 0, sizeof(ge25519));
+			buckets[j].y[0] = 1;
+			buckets[j].z[0] = 1;
+		}
+
+		/* bucket[|d|-1] += sign(d)p */
+		for (i = 0; i < n; i++) {
+			int16_t digit = digits[(c * n) + i];
+			if (digit > 0) {
+				ge25519_nielsadd2_p1p1(&t, &buckets[digit - 1], &pre[i], 0);
+				ge25519_p1p1_to_full(&buckets[digit - 1], &t);
+			} else if (digit < 0) {
+				ge25519_nielsadd2_p1p1(&t, &buckets[-digit - 1], &pre[i], 1);
+				ge25519_p1p1_to_full(&buckets[-digit - 1], &t);
+			}
+		}
+
+		/* sum = 1*bucket[0] + 2*bucket[1] + ... with a running sum from the top */
+		running = buckets[nbuckets - 1];
+		sum = running;
+		for (j = nbuckets - 1; j-- > 0;) {
+			ge25519_add(&running, &running, &buckets[j]);
+			ge25519_add(&sum, &sum, &running);
+		}
+
+		ge25519_add(r, r, &sum);
+	}
+}
+
+/* computes [s1]p1 + ... + [sn]pn with the signed digit bucket method, returns 0 if out of memory */
+static int
+ge25519_multiscalarmult_pippenger_vartime(ge25519 *r, const ge25519 *points, const bignum256modm *scalars, size_t n) {
+	void *scratch = malloc(ge25519_multiscalarmult_pippenger_scratch_size(n));
+
+	if (!scratch)
+		return 0;
+	ge25519_multiscalarmult_pippenger_vartime_scratch(r, points, scalars, n, scratch);
+	free(scratch);
+	return 1;
+}
@@ -20,6 +20,14 @@
 	#endif
 #endif
 
+/* the 4-way IFMA point arithmetic works alongside the 64 bit field arithmetic */
+#if defined(ED25519_AVX512IFMA)
+	#if !defined(ED25519_64BIT) || !defined(CPU_X86_64) || !(defined(COMPILER_GCC) || defined(COMPILER_CLANG))
+		#error "ED25519_AVX512IFMA requires the 64 bit backend and gcc or clang on x86-64"
+	#endif
+	#define ED25519_X4
+#endif
+
 #if !defined(ED25519_NO_INLINE_ASM)
 	/* detect extra features first so un-needed functions can be disabled throughout */
 	#if defined(ED25519_SSE2)
@@ -51,6 +59,10 @@
 
 #include "curve25519-donna-helpers.h"
 
+#if defined(ED25519_AVX512IFMA)
+	#include "curve25519-donna-ifma.h"
+#endif
+
 /* separate uint128 check for 64 bit sse2 */
 #if defined(HAVE_UINT128) && !defined(ED25519_FORCE_32BIT)
 	#include "modm-donna-64bit.h"
@@ -109,6 +121,9 @@ typedef struct ge25519_pniels_t {
 	#include "ed25519-donna-32bit-sse2.h"
 	#include "ed25519-donna-64bit-sse2.h"
 	#include "ed25519-donna-impl-sse2.h"
+#elif defined(ED25519_X4)
+	#include "ed25519-donna-impl-base.h"
+	#include "ed25519-donna-impl-x4.h"
 #else
 	#include "ed25519-donna-impl-base.h"
 #endif
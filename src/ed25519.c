@@ -19,6 +19,9 @@
 #include "ed25519-randombytes.h"
 #include "ed25519-hash.h"
 
+/* the batched key generation and signing paths share one inversion per this many points */
+#define ed25519_pack_batch_size 64
+
 /*
 	Generates a (extsk[0..31]) and aExt (extsk[32..63])
 */
@@ -90,6 +93,91 @@ ED25519_FN(ed25519_sign) (const unsigned char *m, size_t mlen, const ed25519_sec
 	contract256_modm(RS + 32, S);
 }
 
+/*
+	Batched key generation and signing. All of the scalar multiplications in a
+	group of ed25519_pack_batch_size are done first, then the results are packed
+	with a single shared inversion
+*/
+
+void
+ED25519_FN(ed25519_publickey_batch) (const unsigned char **sk, unsigned char **pk, size_t num) {
+	bignum256modm a;
+	ge25519 ALIGN(16) A[ed25519_pack_batch_size];
+	bignum25519 ALIGN(16) zs[ed25519_pack_batch_size], zis[ed25519_pack_batch_size];
+	unsigned char packed[ed25519_pack_batch_size][32];
+	hash_512bits extsk;
+	size_t i, batchsize;
+
+	while (num) {
+		batchsize = (num > ed25519_pack_batch_size) ? ed25519_pack_batch_size : num;
+
+		/* A = aB */
+		for (i = 0; i < batchsize; i++) {
+			ed25519_extsk(extsk, sk[i]);
+			expand256_modm(a, extsk, 32);
+			ge25519_scalarmult_base_niels(&A[i], ge25519_niels_base_multiples, a);
+		}
+
+		ge25519_pack_batch(packed, A, batchsize, zs, zis);
+		for (i = 0; i < batchsize; i++)
+			memcpy(pk[i], packed[i], 32);
+
+		sk += batchsize;
+		pk += batchsize;
+		num -= batchsize;
+	}
+}
+
+void
+ED25519_FN(ed25519_sign_batch) (const unsigned char **m, size_t *mlen, const unsigned char **sk, const unsigned char **pk, unsigned char **RS, size_t num) {
+	ed25519_hash_context ctx;
+	bignum256modm r[ed25519_pack_batch_size], a[ed25519_pack_batch_size], S;
+	ge25519 ALIGN(16) R[ed25519_pack_batch_size];
+	bignum25519 ALIGN(16) zs[ed25519_pack_batch_size], zis[ed25519_pack_batch_size];
+	unsigned char packed[ed25519_pack_batch_size][32];
+	hash_512bits extsk, hashr, hram;
+	size_t i, batchsize;
+
+	while (num) {
+		batchsize = (num > ed25519_pack_batch_size) ? ed25519_pack_batch_size : num;
+
+		for (i = 0; i < batchsize; i++) {
+			ed25519_extsk(extsk, sk[i]);
+			expand256_modm(a[i], extsk, 32);
+
+			/* r = H(aExt[32..64], m) */
+			ed25519_hash_init(&ctx);
+			ed25519_hash_update(&ctx, extsk + 32, 32);
+			ed25519_hash_update(&ctx, m[i], mlen[i]);
+			ed25519_hash_final(&ctx, hashr);
+			expand256_modm(r[i], hashr, 64);
+
+			/* R = rB */
+			ge25519_scalarmult_base_niels(&R[i], ge25519_niels_base_multiples, r[i]);
+		}
+
+		ge25519_pack_batch(packed, R, batchsize, zs, zis);
+
+		for (i = 0; i < batchsize; i++) {
+			memcpy(RS[i], packed[i], 32);
+
+			/* S = (r + H(R,A,m)a) mod L */
+			ed25519_hram(hram, RS[i], pk[i], m[i], mlen[i]);
+			expand256_modm(S, hram, 64);
+			mul256_modm(S, S, a[i]);
+			add256_modm(S, S, r[i]);
+			contract256_modm(RS[i] + 32, S);
+		}
+
+		m += batchsize;
+		mlen += batchsize;
+		sk += batchsize;
+		pk += batchsize;
+		RS += batchsize;
+		num -= batchsize;
+	}
+}
+
 int
 ED25519_FN(ed25519_sign_open) (const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS) {
 	ge25519 ALIGN(16) R, A;
@@ -115,6 +203,7 @@ ED25519_FN(ed25519_sign_open) (const unsigned char *m, size_t mlen, const ed2551
 	return ed25519_verify(RS, checkR, 32) ? 0 : -1;
 }
 
+#include "ed25519-donna-multiscalar.h"
 #include "ed25519-donna-batchverify.h"
 
 /*
@@ -148,3 +237,62 @@ ED25519_FN(curved25519_scalarmult_basepoint) (curved25519_key pk, const curved25
 	curve25519_contract(pk, yplusz);
 }
 
+/*
+	Batched Curve25519 basepoint scalar multiplication, sharing one inversion
+	across each group of ed25519_pack_batch_size keys
+*/
+
+void
+ED25519_FN(curved25519_scalarmult_basepoint_batch) (curved25519_key *pk, const curved25519_key *e, size_t num) {
+	curved25519_key ec;
+	bignum256modm s;
+	bignum25519 ALIGN(16) yplusz[ed25519_pack_batch_size], zminusy[ed25519_pack_batch_size], zinv[ed25519_pack_batch_size];
+	ge25519 ALIGN(16) p;
+	size_t i, batchsize;
+
+	while (num) {
+		batchsize = (num > ed25519_pack_batch_size) ? ed25519_pack_batch_size : num;
+
+		for (i = 0; i < batchsize; i++) {
+			/* clamp */
+			memcpy(ec, e[i], 32);
+			ec[0] &= 248;
+			ec[31] &= 127;
+			ec[31] |= 64;
+
+			expand_raw256_modm(s, ec);
+
+			/* scalar * basepoint */
+			ge25519_scalarmult_base_niels(&p, ge25519_niels_base_multiples, s);
+
+			curve25519_add(yplusz[i], p.y, p.z);
+			curve25519_sub(zminusy[i], p.z, p.y);
+		}
+
+		/* u = (y + z) / (z - y) */
+		curve25519_batch_recip(zinv, zminusy, batchsize);
+		for (i = 0; i < batchsize; i++) {
+			curve25519_mul(yplusz[i], yplusz[i], zinv[i]);
+			curve25519_contract(pk[i], yplusz[i]);
+		}
+
+		pk += batchsize;
+		e += batchsize;
+		num -= batchsize;
+	}
+}
+
+const char *
+ED25519_FN(ed25519_backend) (void) {
+#if defined(ED25519_X4)
+	if (curve25519x4_available())
+		return ED25519_X4_BACKEND;
+#endif
+#if defined(ED25519_SSE2)
+	return "sse2";
+#elif defined(ED25519_64BIT)
+	return "64bit";
+#else
+	return "32bit";
+#endif
+}
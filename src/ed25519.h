@@ -17,11 +17,34 @@ void ed25519_publickey(const ed25519_secret_key sk, ed25519_public_key pk);
 int ed25519_sign_open(const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS);
 void ed25519_sign(const unsigned char *m, size_t mlen, const ed25519_secret_key sk, const ed25519_public_key pk, ed25519_signature RS);
 
+void ed25519_publickey_batch(const unsigned char **sk, unsigned char **pk, size_t num);
+void ed25519_sign_batch(const unsigned char **m, size_t *mlen, const unsigned char **sk, const unsigned char **pk, unsigned char **RS, size_t num);
+
+/*
+	batch verification returns 0 if every signature is valid. otherwise the
+	result has 1 set, and also 2 if the batch failed as one combination and
+	was bisected to find the bad signatures. a signature whose R or public
+	key does not decode is left out of the combination and verified on its
+	own, so it only sets 1. valid[i] is 1 for each good signature. the same
+	holds for ed25519_batch_finalize
+*/
 int ed25519_sign_open_batch(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid);
+size_t ed25519_sign_open_batch_scratch_size(size_t num);
+int ed25519_sign_open_batch_scratch(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, void *scratch, size_t scratch_size);
+int ed25519_sign_open_batch_mt(const unsigned char **m, size_t *mlen, const unsigned char **pk, const unsigned char **RS, size_t num, int *valid, size_t nthreads);
+
+typedef struct ed25519_batch_t ed25519_batch;
+ed25519_batch *ed25519_batch_init(void);
+int ed25519_batch_add(ed25519_batch *ctx, const unsigned char *m, size_t mlen, const ed25519_public_key pk, const ed25519_signature RS);
+int ed25519_batch_finalize(ed25519_batch *ctx, int *valid);
 
 void ed25519_randombytes_unsafe(void *out, size_t count);
 
 void curved25519_scalarmult_basepoint(curved25519_key pk, const curved25519_key e);
+void curved25519_scalarmult_basepoint_batch(curved25519_key *pk, const curved25519_key *e, size_t num);
+
+/* name of the field arithmetic in use, which may be picked at runtime */
+const char *ed25519_backend(void);
 
 #if defined(__cplusplus)
 }
@@ -120,6 +120,24 @@ add256_modm(bignum256modm r, const bignum256modm x, const bignum256modm y) {
 	reduce256_modm(r);
 }
 
+/* subtraction modulo m, y must be reduced */
+static void
+sub256_modm(bignum256modm r, const bignum256modm x, const bignum256modm y) {
+	bignum256modm t;
+	bignum256modm_element_t b = 0, pb;
+
+	/* t = m - y, in (0, m] */
+	pb = 0;
+	pb += y[0]; b = lt_modm(modm_m[0], pb); t[0] = (modm_m[0] - pb + (b << 56)); pb = b;
+	pb += y[1]; b = lt_modm(modm_m[1], pb); t[1] = (modm_m[1] - pb + (b << 56)); pb = b;
+	pb += y[2]; b = lt_modm(modm_m[2], pb); t[2] = (modm_m[2] - pb + (b << 56)); pb = b;
+	pb += y[3]; b = lt_modm(modm_m[3], pb); t[3] = (modm_m[3] - pb + (b << 56)); pb = b;
+	pb += y[4]; b = lt_modm(modm_m[4], pb); t[4] = (modm_m[4] - pb + (b << 32));
+
+	/* r = x + t, reduced back below m */
+	add256_modm(r, x, t);
+}
+
 static void
 mul256_modm(bignum256modm r, const bignum256modm x, const bignum256modm y) {
 	bignum256modm q1, r1;
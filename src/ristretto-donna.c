@@ -9,11 +9,18 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "ristretto-donna.h"
+#include "ed25519-donna-multiscalar.h"
+#include "ed25519-hash.h"
 
 static uint8_t uchar_ct_eq(const uint8_t a, const uint8_t b);
 static uint8_t bignum25519_is_negative(unsigned char bytes[32]);
+static void ge25519_set_neutral(ge25519 *p);
+static void ge25519_pniels_set_neutral(ge25519_pniels *p);
+static void ge25519_pniels_move_conditional(ge25519_pniels *out, const ge25519_pniels *in, uint8_t flag);
+static void ge25519_scalarmult_choose_pniels(ge25519_pniels *t, const ge25519_pniels table[8], signed char b);
 
 /**
  * Check if two bytes are equal in constant time.
@@ -39,7 +46,7 @@ static uint8_t uchar_ct_eq(const unsigned char a, const unsigned char b)
  * x-coordinate was negative.
  **/
 void ge25519_pack_without_parity(unsigned char bytes[32], const ge25519 *p) {
-	bignum25519 tx, ty, zi;
+	bignum25519 ALIGN(16) tx, ty, zi;
 
 	curve25519_recip(zi, p->z);
 	curve25519_mul(tx, p->x, zi);
@@ -94,9 +101,30 @@ static uint8_t bignum25519_is_negative(unsigned char bytes[32])
   return low_bit_is_set;
 }
 
-uint8_t curve25519_sqrt_ratio_i(bignum25519 out, const bignum25519 u, const bignum25519 v)
+/**
+ * First half of `curve25519_sqrt_ratio_i()`: compute `u*v⁷`, which is to be
+ * raised to `(p-5)/8`, along with `v³`.
+ */
+static void curve25519_sqrt_ratio_i_prepare(bignum25519 uv7, bignum25519 v3,
+                                            const bignum25519 u, const bignum25519 v)
+{
+  bignum25519 ALIGN(16) tmp, v7;
+
+  curve25519_square(tmp, v);      // v²
+  curve25519_mul(v3, tmp, v);     // v³
+  curve25519_square(tmp, v3);      // v⁶
+  curve25519_mul(v7, tmp, v);     // v⁷
+  curve25519_mul(uv7, u, v7);     // u*v^7
+}
+
+/**
+ * Second half of `curve25519_sqrt_ratio_i()`, given `pow = (u*v⁷)^{(p-5)/8}`.
+ */
+static uint8_t curve25519_sqrt_ratio_i_finish(bignum25519 out,
+                                              const bignum25519 u, const bignum25519 v,
+                                              const bignum25519 v3, const bignum25519 pow)
 {
-  bignum25519 tmp, v3, v7, r, r_prime, r_negative, check, i, u_neg, u_neg_i;
+  bignum25519 ALIGN(16) tmp, r, r_prime, r_negative, check, u_neg, u_neg_i;
   unsigned char r_bytes[32];
   uint8_t r_is_negative;
   uint8_t correct_sign_sqrt;
@@ -105,15 +133,7 @@ uint8_t curve25519_sqrt_ratio_i(bignum25519 out, const bignum25519 u, const bign
   uint8_t was_nonzero_square;
   uint8_t should_rotate;
 
-  PRINT("sqrt_ratio_i with u,v = "); fe_print(u); fe_print(v);
-
-  curve25519_square(tmp, v);      // v²
-  curve25519_mul(v3, tmp, v);     // v³
-  curve25519_square(tmp, v3);      // v⁶
-  curve25519_mul(v7, tmp, v);     // v⁷
-  curve25519_mul(tmp, u, v7);     // u*v^7
-  curve25519_pow_two252m3(r, tmp); // (u*v^7)^{(p-5)/8}
-  curve25519_mul(r, r, u);        // (u)*(u*v^7)^{(p-5)/8}
+  curve25519_mul(r, pow, u);      // (u)*(u*v^7)^{(p-5)/8}
   curve25519_mul(r, r, v3);        // (u)*(u*v^7)^{(p-5)/8}
   curve25519_square(tmp, r);       // tmp = r^2
   curve25519_mul(check, v, tmp);  // check = r^2 * v
@@ -151,6 +171,18 @@ uint8_t curve25519_sqrt_ratio_i(bignum25519 out, const bignum25519 u, const bign
   return was_nonzero_square;
 }
 
+uint8_t curve25519_sqrt_ratio_i(bignum25519 out, const bignum25519 u, const bignum25519 v)
+{
+  bignum25519 ALIGN(16) uv7, v3, pow;
+
+  PRINT("sqrt_ratio_i with u,v = "); fe_print(u); fe_print(v);
+
+  curve25519_sqrt_ratio_i_prepare(uv7, v3, u, v);
+  curve25519_pow_two252m3(pow, uv7); // (u*v^7)^{(p-5)/8}
+
+  return curve25519_sqrt_ratio_i_finish(out, u, v, v3, pow);
+}
+
 /**
  * Calculate either `sqrt(1/v)` for a field element `v`.
  *
@@ -165,25 +197,20 @@ uint8_t curve25519_invsqrt(bignum25519 out, const bignum25519 v)
 }
 
 /**
- * Attempt to decompress `bytes` to a Ristretto group `element`.
+ * First half of `ristretto_decode()`: decode `s` from `bytes` and compute
+ * `u1 = 1 + as²`, `u2 = 1 - as²`, `v = ad(1+as²)² - (1-as²)²` and `w = v*u2²`,
+ * whose inverse square root is needed next.
  *
- * Returns 0 if the point could not be decoded and 1 otherwise.
+ * Returns 0 if the encoding of `s` was non-canonical or negative, in which
+ * case the outputs are still well-defined field elements.
  */
-int ristretto_decode(ristretto_point_t *element, const unsigned char bytes[32])
+static uint8_t ristretto_decode_prepare(bignum25519 s, bignum25519 u1, bignum25519 u2,
+                                        bignum25519 v, bignum25519 w, const unsigned char bytes[32])
 {
-  bignum25519 s, ss;
-  bignum25519 u1, u1_sqr, u2, u2_sqr;
-  bignum25519 v, i, minus_d, dx, dy, x, y, t;
-  bignum25519 tmp;
+  bignum25519 ALIGN(16) ss, u1_sqr, u2_sqr, minus_d, tmp;
   unsigned char s_bytes_check[32];
-  unsigned char x_bytes[32];
-  unsigned char t_bytes[32];
   uint8_t s_encoding_is_canonical;
   uint8_t s_is_negative;
-  uint8_t x_is_negative;
-  uint8_t t_is_negative;
-  uint8_t y_is_zero;
-  uint8_t ok;
 
   // Step 1: Check that the encoding of the field element is canonical
   curve25519_expand(s, bytes);
@@ -192,11 +219,6 @@ int ristretto_decode(ristretto_point_t *element, const unsigned char bytes[32])
   s_encoding_is_canonical = uint8_32_ct_eq(bytes, s_bytes_check);
   s_is_negative = bignum25519_is_negative(s_bytes_check);
 
-  // Bail out if the field element encoding was non-canonical or negative
-  if (s_encoding_is_canonical == 0 || s_is_negative == 1) {
-      return 0;
-  }
-
   // Step 2: Compute (X:Y:Z:T)
   // XXX can we eliminate these reductions
   curve25519_square(ss, s);
@@ -207,9 +229,29 @@ int ristretto_decode(ristretto_point_t *element, const unsigned char bytes[32])
   curve25519_neg(minus_d, EDWARDS_D);    // -d               // XXX store as const?
   curve25519_mul(tmp, minus_d, u1_sqr);  // ad(1+as²)²
   curve25519_sub_reduce(v, tmp, u2_sqr); // ad(1+as²)² - (1-as²)²
-  curve25519_mul(tmp, v, u2_sqr);        // v = (ad(1+as²)² - (1-as²)²)(1-as²)²
+  curve25519_mul(w, v, u2_sqr);          // w = (ad(1+as²)² - (1-as²)²)(1-as²)²
 
-  ok = curve25519_invsqrt(i, tmp);       // i = 1/sqrt{(ad(1+as²)² - (1-as²)²)(1-as²)²}
+  return s_encoding_is_canonical & (s_is_negative ^ 1);
+}
+
+/**
+ * Second half of `ristretto_decode()`, given `i = 1/sqrt(w)` and whether `w`
+ * was a non-zero square.
+ *
+ * Returns 0 and leaves `element` untouched if the point could not be
+ * decoded, and 1 otherwise.
+ */
+static int ristretto_decode_finish(ristretto_point_t *element,
+                                   const bignum25519 s, const bignum25519 u1, const bignum25519 u2,
+                                   const bignum25519 v, const bignum25519 i, uint8_t ok)
+{
+  bignum25519 ALIGN(16) dx, dy, x, y, t, tmp;
+  const bignum25519 ALIGN(16) zero = {0};
+  unsigned char x_bytes[32];
+  unsigned char t_bytes[32];
+  uint8_t x_is_negative;
+  uint8_t t_is_negative;
+  uint8_t y_is_zero;
 
   // Step 3: Calculate x and y denominators, then compute x.
   curve25519_mul(dx, i, u2);             // 1/sqrt(v)
@@ -218,7 +260,7 @@ int ristretto_decode(ristretto_point_t *element, const unsigned char bytes[32])
   curve25519_add_reduce(tmp, s, s);      // 2s
   curve25519_mul(x, tmp, dx);            // x = |2s/sqrt(v)| = +sqrt(4s²/(ad(1+as²)² - (1-as²)²))
   curve25519_contract(x_bytes, x);
-  
+
   // Step 4: Conditionally negate x if it's negative.
   x_is_negative = bignum25519_is_negative(x_bytes);
 
@@ -229,8 +271,9 @@ int ristretto_decode(ristretto_point_t *element, const unsigned char bytes[32])
   curve25519_mul(y, u1, dy);
   curve25519_mul(t, x, y);
   curve25519_contract(t_bytes, t);
-  
+
   t_is_negative = bignum25519_is_negative(t_bytes);
+  y_is_zero = bignum25519_ct_eq(y, zero);
 
   if (ok == 0 || t_is_negative == 1 || y_is_zero == 1) {
     return 0;
@@ -245,17 +288,33 @@ int ristretto_decode(ristretto_point_t *element, const unsigned char bytes[32])
 }
 
 /**
- * Encode a ristretto element to an array of 32 bytes.
+ * Attempt to decompress `bytes` to a Ristretto group `element`.
+ *
+ * Returns 0 if the point could not be decoded and 1 otherwise.
  */
-void ristretto_encode(unsigned char bytes[32], const ristretto_point_t *element)
+int ristretto_decode(ristretto_point_t *element, const unsigned char bytes[32])
 {
-  bignum25519 u1, u2, u22, i1, i2, z_inv, den_inv, ix, iy, invsqrt, tmp1, tmp2;
-  bignum25519 x, y, y_neg, s, s_neg;
-  bignum25519 enchanted_denominator;
-  unsigned char contracted[32];
-  uint8_t x_zinv_is_negative;
-  uint8_t s_is_negative;
-  uint8_t rotate;
+  bignum25519 ALIGN(16) s, u1, u2, v, w, i;
+  uint8_t ok;
+
+  // Bail out if the field element encoding was non-canonical or negative
+  if (ristretto_decode_prepare(s, u1, u2, v, w, bytes) == 0) {
+    return 0;
+  }
+
+  ok = curve25519_invsqrt(i, w);         // i = 1/sqrt{(ad(1+as²)² - (1-as²)²)(1-as²)²}
+
+  return ristretto_decode_finish(element, s, u1, u2, v, i, ok);
+}
+
+/**
+ * First half of `ristretto_encode()`: compute `u1 = z²-y²`, `u2 = xy` and
+ * `w = x²y²(z²-y²)`, whose inverse square root is needed next.
+ */
+static void ristretto_encode_prepare(bignum25519 u1, bignum25519 u2, bignum25519 w,
+                                     const ristretto_point_t *element)
+{
+  bignum25519 ALIGN(16) u22, tmp1, tmp2;
 
   curve25519_add_reduce(tmp1, element->point.z, element->point.y); // t1 = z+y
   curve25519_sub_reduce(tmp2, element->point.z, element->point.y); // t2 = z-y
@@ -263,10 +322,22 @@ void ristretto_encode(unsigned char bytes[32], const ristretto_point_t *element)
   curve25519_mul(u2, element->point.x, element->point.y);          // u2 = xy
 
   curve25519_square(u22, u2);                                      // u22 = x²y²
-  curve25519_mul(tmp1, u1, u22);                                   // t1  = x²y²(z²-y²)
+  curve25519_mul(w, u1, u22);                                      // w  = x²y²(z²-y²)
+}
 
-  // This is always square so we don't need to check the return value
-  curve25519_invsqrt(invsqrt, tmp1);                               // invsqrt = sqrt(1/(x²y²(z²-y²)))
+/**
+ * Second half of `ristretto_encode()`, given `invsqrt = sqrt(1/w)`.
+ */
+static void ristretto_encode_finish(unsigned char bytes[32], const ristretto_point_t *element,
+                                    const bignum25519 u1, const bignum25519 u2, const bignum25519 invsqrt)
+{
+  bignum25519 ALIGN(16) i1, i2, z_inv, ix, iy, tmp1;
+  bignum25519 ALIGN(16) x, y, y_neg, s, s_neg;
+  bignum25519 ALIGN(16) enchanted_denominator;
+  unsigned char contracted[32];
+  uint8_t x_zinv_is_negative;
+  uint8_t s_is_negative;
+  uint8_t rotate;
 
   curve25519_mul(i1, invsqrt, u1);                                 // den1 = (z²-y²)/sqrt(x²y²(z²-y²))
   curve25519_mul(i2, invsqrt, u2);                                 // den2 = xy/sqrt(x²y²(z²-y²))
@@ -313,6 +384,21 @@ void ristretto_encode(unsigned char bytes[32], const ristretto_point_t *element)
   curve25519_contract(bytes, s);
 }
 
+/**
+ * Encode a ristretto element to an array of 32 bytes.
+ */
+void ristretto_encode(unsigned char bytes[32], const ristretto_point_t *element)
+{
+  bignum25519 ALIGN(16) u1, u2, w, invsqrt;
+
+  ristretto_encode_prepare(u1, u2, w, element);
+
+  // This is always square so we don't need to check the return value
+  curve25519_invsqrt(invsqrt, w);                                  // invsqrt = sqrt(1/(x²y²(z²-y²)))
+
+  ristretto_encode_finish(bytes, element, u1, u2, invsqrt);
+}
+
 /**
  * Test equality of two `ristretto_point_t`s in constant time.
  *
@@ -320,7 +406,7 @@ void ristretto_encode(unsigned char bytes[32], const ristretto_point_t *element)
  */
 int ristretto_ct_eq(const ristretto_point_t *a, const ristretto_point_t *b)
 {
-  bignum25519 x1y2, y1x2, x1x2, y1y2;
+  bignum25519 ALIGN(16) x1y2, y1x2, x1x2, y1y2;
   uint8_t check_one, check_two;
 
   curve25519_mul(x1y2, a->point.x, b->point.y);
@@ -333,3 +419,1136 @@ int ristretto_ct_eq(const ristretto_point_t *a, const ristretto_point_t *b)
 
   return check_one | check_two;
 }
+
+/**
+ * Set `p` to the identity element, (0:1:1:0).
+ */
+static void ge25519_set_neutral(ge25519 *p)
+{
+  memset(p, 0, sizeof(ge25519));
+  p->y[0] = 1;
+  p->z[0] = 1;
+}
+
+/**
+ * Set `p` to the identity element in projective Niels form, i.e. with
+ * `y-x = 1`, `y+x = 1`, `z = 1` and `2dt = 0`.
+ */
+static void ge25519_pniels_set_neutral(ge25519_pniels *p)
+{
+  memset(p, 0, sizeof(ge25519_pniels));
+  p->ysubx[0] = 1;
+  p->xaddy[0] = 1;
+  p->z[0] = 1;
+}
+
+/**
+ * Set `out` to `in` iff `flag` is 1, and leave it untouched if `flag` is 0,
+ * in constant time.
+ */
+static void ge25519_pniels_move_conditional(ge25519_pniels *out, const ge25519_pniels *in, uint8_t flag)
+{
+  ge25519_pniels ALIGN(16) tmp;
+
+  // Swap against a scratch copy so that `in` is never written to.
+  memcpy(&tmp, in, sizeof(ge25519_pniels));
+
+  curve25519_swap_conditional(out->ysubx, tmp.ysubx, flag);
+  curve25519_swap_conditional(out->xaddy, tmp.xaddy, flag);
+  curve25519_swap_conditional(out->z, tmp.z, flag);
+  curve25519_swap_conditional(out->t2d, tmp.t2d, flag);
+}
+
+/**
+ * Select `[b]P` from a `table` holding `[1]P, [2]P, ..., [8]P`, for a signed
+ * digit `-8 <= b <= 8`, in constant time.
+ *
+ * Every entry of the table is touched regardless of `b`, and the sign of `b`
+ * is applied afterwards with conditional swaps rather than branches.
+ */
+static void ge25519_scalarmult_choose_pniels(ge25519_pniels *t, const ge25519_pniels table[8], signed char b)
+{
+  bignum25519 ALIGN(16) neg;
+  uint8_t sign = (uint8_t)((unsigned char)b >> 7);
+  uint8_t mask = (uint8_t)(~(sign - 1));
+  uint8_t u = (uint8_t)((b + mask) ^ mask); // |b|
+  uint8_t i;
+
+  ge25519_pniels_set_neutral(t);
+
+  for (i = 0; i < 8; i++) {
+    ge25519_pniels_move_conditional(t, &table[i], uchar_ct_eq(u, i + 1));
+  }
+
+  // -(x,y,z,t) = (-x,y,z,-t), which in Niels form swaps y-x with y+x
+  curve25519_swap_conditional(t->ysubx, t->xaddy, sign);
+  curve25519_neg(neg, t->t2d);
+  curve25519_swap_conditional(t->t2d, neg, sign);
+}
+
+/**
+ * Compute `out = [scalar]p` in constant time.
+ *
+ * The scalar is reduced modulo the group order and recoded into 64 signed
+ * radix-16 digits, each in `[-8, 8]`.  A table of `[1]p, ..., [8]p` is built
+ * once per call, after which each digit costs four doublings and a single
+ * constant-time table lookup and addition.
+ */
+void ristretto_scalarmult(ristretto_point_t *out, const ristretto_point_t *p, const unsigned char scalar[32])
+{
+  ge25519_pniels ALIGN(16) table[8], t;
+  ge25519 ALIGN(16) r, d;
+  ge25519_p1p1 ALIGN(16) tmp;
+  bignum256modm s;
+  signed char b[64];
+  int i;
+
+  expand256_modm(s, scalar, 32);
+  contract256_window4_modm(b, s);
+
+  // table[i] = [i+1]p
+  ge25519_full_to_pniels(&table[0], &p->point);
+  for (i = 0; i < 7; i++) {
+    ge25519_pnielsadd_p1p1(&tmp, &p->point, &table[i], 0);
+    ge25519_p1p1_to_full(&d, &tmp);
+    ge25519_full_to_pniels(&table[i+1], &d);
+  }
+
+  ge25519_set_neutral(&r);
+  ge25519_scalarmult_choose_pniels(&t, table, b[63]);
+  ge25519_pnielsadd_p1p1(&tmp, &r, &t, 0);
+  ge25519_p1p1_to_full(&r, &tmp);
+
+  for (i = 62; i >= 0; i--) {
+    // r = [16]r
+    ge25519_double_partial(&r, &r);
+    ge25519_double_partial(&r, &r);
+    ge25519_double_partial(&r, &r);
+    ge25519_double(&r, &r);
+
+    // r = r + [b[i]]p, where only the last addition needs t
+    ge25519_scalarmult_choose_pniels(&t, table, b[i]);
+    ge25519_pnielsadd_p1p1(&tmp, &r, &t, 0);
+    if (i > 0) {
+      ge25519_p1p1_to_partial(&r, &tmp);
+    } else {
+      ge25519_p1p1_to_full(&r, &tmp);
+    }
+  }
+
+  memcpy(&out->point, &r, sizeof(ge25519));
+}
+
+/**
+ * Compute `out = [scalar]B`, where `B` is the Ristretto basepoint, in
+ * constant time.
+ *
+ * This uses the precomputed radix-16 table of basepoint multiples shared
+ * with Ed25519, and so is considerably faster than calling
+ * `ristretto_scalarmult()` with `RISTRETTO_BASEPOINT_POINT`.
+ */
+void ristretto_scalarmult_base(ristretto_point_t *out, const unsigned char scalar[32])
+{
+  bignum256modm s;
+
+  expand256_modm(s, scalar, 32);
+  ge25519_scalarmult_base_niels(&out->point, ge25519_niels_base_multiples, s);
+}
+
+/**
+ * Precompute the fixed-base table of multiples of `p`, so that
+ * `ristretto_basepoint_table_mul()` can compute `[s]p` as quickly as
+ * `ristretto_scalarmult_base()` computes `[s]B`.
+ *
+ * This takes 256 field inversions and is meant to be done once per
+ * generator.  As in `ge25519_niels_base_multiples`, the first row stores
+ * `2xy` rather than `2dxy`, since `ge25519_scalarmult_base_niels()` uses it
+ * both to seed the accumulator's `t` and, once multiplied by `d`, as an
+ * addend.
+ */
+void ristretto_basepoint_table_create(ristretto_basepoint_table_t *table, const ristretto_point_t *p)
+{
+  ge25519 ALIGN(16) base, acc;
+  bignum25519 ALIGN(16) zi, x, y, t;
+  int i, j;
+
+  memcpy(&base, &p->point, sizeof(ge25519));
+
+  for (i = 0; i < 32; i++) {
+    memcpy(&acc, &base, sizeof(ge25519));
+
+    for (j = 0; j < 8; j++) {
+      if (j > 0) {
+        ge25519_add(&acc, &acc, &base);
+      }
+
+      curve25519_recip(zi, acc.z);
+      curve25519_mul(x, acc.x, zi);
+      curve25519_mul(y, acc.y, zi);
+
+      curve25519_sub_reduce(t, y, x);
+      curve25519_contract(&table->table[i*8 + j][0], t);
+      curve25519_add_reduce(t, y, x);
+      curve25519_contract(&table->table[i*8 + j][32], t);
+
+      curve25519_mul(t, x, y);
+      curve25519_add_reduce(t, t, t);
+      if (i > 0) {
+        curve25519_mul(t, t, ge25519_ecd);
+      }
+      curve25519_contract(&table->table[i*8 + j][64], t);
+    }
+
+    // base = [256]base
+    for (j = 0; j < 7; j++) {
+      ge25519_double_partial(&base, &base);
+    }
+    ge25519_double(&base, &base);
+  }
+}
+
+/**
+ * Compute `out = [scalar]P` in constant time, where `table` was built from
+ * `P` by `ristretto_basepoint_table_create()`.
+ */
+void ristretto_basepoint_table_mul(ristretto_point_t *out, const ristretto_basepoint_table_t *table, const unsigned char scalar[32])
+{
+  bignum256modm s;
+
+  expand256_modm(s, scalar, 32);
+  ge25519_scalarmult_base_niels(&out->point, table->table, s);
+}
+
+/**
+ * Little-endian encoding for the serialized table header.  The portable
+ * header's `U32TO8_LE`/`U8TO32_LE` are only defined for some backends.
+ */
+static void store_uint32_le(unsigned char *p, uint32_t v)
+{
+  p[0] = (unsigned char)(v);
+  p[1] = (unsigned char)(v >> 8);
+  p[2] = (unsigned char)(v >> 16);
+  p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t load_uint32_le(const unsigned char *p)
+{
+  return ((uint32_t)p[0]) | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const unsigned char RISTRETTO_TABLE_MAGIC[8] = {'r', '2', '5', '5', 't', 'b', 'l', 0};
+
+#if defined(ED25519_SSE2)
+#define RISTRETTO_TABLE_BACKEND RISTRETTO_TABLE_BACKEND_SSE2
+#elif defined(ED25519_64BIT)
+#define RISTRETTO_TABLE_BACKEND RISTRETTO_TABLE_BACKEND_64BIT
+#else
+#define RISTRETTO_TABLE_BACKEND RISTRETTO_TABLE_BACKEND_32BIT
+#endif
+
+/**
+ * Serialize `table` into `out`, which must hold at least
+ * `RISTRETTO_TABLE_SERIALIZED_SIZE` bytes.  If the result is to be used in
+ * place by `ristretto_basepoint_table_load()`, it should be written at a
+ * 16-byte aligned offset, e.g. at the start of a file.
+ *
+ * Returns 1 on success and 0 if `out` is too small.
+ */
+int ristretto_basepoint_table_store(unsigned char *out, size_t outlen, const ristretto_basepoint_table_t *table)
+{
+  unsigned char digest[64];
+
+  if (outlen < RISTRETTO_TABLE_SERIALIZED_SIZE) {
+    return 0;
+  }
+
+  ed25519_hash(digest, &table->table[0][0], sizeof(table->table));
+
+  memset(out, 0, RISTRETTO_TABLE_HEADER_SIZE);
+  memcpy(out, RISTRETTO_TABLE_MAGIC, 8);
+  store_uint32_le(out + 8, RISTRETTO_TABLE_VERSION);
+  store_uint32_le(out + 12, RISTRETTO_TABLE_BACKEND);
+  store_uint32_le(out + 16, 4);
+  store_uint32_le(out + 20, 256);
+  store_uint32_le(out + 24, 96);
+  memcpy(out + 32, digest, 32);
+  memcpy(out + RISTRETTO_TABLE_HEADER_SIZE, table->table, sizeof(table->table));
+
+  return 1;
+}
+
+/**
+ * Validate a serialized table in `in` and point `*table` at it, without
+ * copying.  `in` is typically a read-only `mmap()` of a file written from
+ * `ristretto_basepoint_table_store()`, and must outlive `*table`.
+ *
+ * Returns 1 on success and 0 if `in` is truncated, misaligned, has the
+ * wrong magic, version or dimensions, or fails its checksum.
+ */
+int ristretto_basepoint_table_load(const ristretto_basepoint_table_t **table, const unsigned char *in, size_t inlen)
+{
+  const unsigned char *body = in + RISTRETTO_TABLE_HEADER_SIZE;
+  unsigned char digest[64];
+
+  *table = NULL;
+
+  if (inlen < RISTRETTO_TABLE_SERIALIZED_SIZE) {
+    return 0;
+  }
+  // The table is read with aligned SIMD loads
+  if (((uintptr_t)body & 15) != 0) {
+    return 0;
+  }
+  if (memcmp(in, RISTRETTO_TABLE_MAGIC, 8) != 0 ||
+      load_uint32_le(in + 8) != RISTRETTO_TABLE_VERSION ||
+      load_uint32_le(in + 16) != 4 ||
+      load_uint32_le(in + 20) != 256 ||
+      load_uint32_le(in + 24) != 96) {
+    return 0;
+  }
+
+  ed25519_hash(digest, body, sizeof(((ristretto_basepoint_table_t*)0)->table));
+  if (!uint8_32_ct_eq(digest, in + 32)) {
+    return 0;
+  }
+
+  *table = (const ristretto_basepoint_table_t*)body;
+
+  return 1;
+}
+
+/**
+ * Compute `out = [a]p + [b]B`, where `B` is the Ristretto basepoint.
+ *
+ * This runs in variable time, and thus must only be used when all of its
+ * inputs are public, e.g. for signature verification.  Sliding windows are
+ * used for both scalars, with the basepoint's odd multiples coming from the
+ * precomputed `ge25519_niels_sliding_multiples` table.
+ */
+void ristretto_double_scalarmult_vartime(ristretto_point_t *out, const ristretto_point_t *p, const bignum256modm a, const bignum256modm b)
+{
+  ge25519_double_scalarmult_vartime(&out->point, &p->point, a, b);
+}
+
+/**
+ * Compute `out = [s_1]P_1 + ... + [s_n]P_n` using Straus' method.
+ *
+ * Returns 1 on success and 0 if scratch space could not be allocated.
+ */
+int ristretto_multiscalar_mul_straus_vartime(ristretto_point_t *out,
+                                             const ristretto_point_t *points,
+                                             const bignum256modm *scalars,
+                                             size_t n)
+{
+  return ge25519_multiscalarmult_straus_vartime(&out->point, (const ge25519*)points, scalars, n);
+}
+
+/**
+ * Compute `out = [s_1]P_1 + ... + [s_n]P_n` using Pippenger's method.
+ *
+ * Returns 1 on success and 0 if scratch space could not be allocated.
+ */
+int ristretto_multiscalar_mul_pippenger_vartime(ristretto_point_t *out,
+                                                const ristretto_point_t *points,
+                                                const bignum256modm *scalars,
+                                                size_t n)
+{
+  return ge25519_multiscalarmult_pippenger_vartime(&out->point, (const ge25519*)points, scalars, n);
+}
+
+/**
+ * Compute `out = [s_1]P_1 + ... + [s_n]P_n` for `n` public points and
+ * scalars, in variable time.
+ *
+ * Straus' method is used below `multiscalar_pippenger_threshold` terms, and
+ * Pippenger's bucket method with a window chosen from `n` above it.  There
+ * is no upper bound on `n`; scratch space is allocated on the heap.
+ *
+ * Returns 1 on success and 0 if scratch space could not be allocated.
+ */
+int ristretto_multiscalar_mul_vartime(ristretto_point_t *out,
+                                      const ristretto_point_t *points,
+                                      const bignum256modm *scalars,
+                                      size_t n)
+{
+  if (n < multiscalar_pippenger_threshold) {
+    return ristretto_multiscalar_mul_straus_vartime(out, points, scalars, n);
+  }
+  return ristretto_multiscalar_mul_pippenger_vartime(out, points, scalars, n);
+}
+
+/**
+ * Normalize each of the `n` points in `in` to `Z = 1`, sharing a single
+ * field inversion, and store them in the compact form in `out`.
+ *
+ * Returns 1 on success and 0 if scratch space could not be allocated.
+ */
+int ristretto_batch_normalize(ristretto_affine_point_t *out, const ristretto_point_t *in, size_t n)
+{
+  bignum25519 *scratch;
+
+  if (n == 0) {
+    return 1;
+  }
+
+  scratch = (bignum25519*)malloc(2 * n * sizeof(bignum25519));
+  if (scratch == NULL) {
+    return 0;
+  }
+
+  // ristretto_point_t and ristretto_affine_point_t are single-member
+  // wrappers, so arrays of them are arrays of the underlying points
+  ge25519_full_to_niels_batch((ge25519_niels*)out, (const ge25519*)in, n, scratch, scratch + n);
+
+  free(scratch);
+
+  return 1;
+}
+
+/**
+ * Convert `in` back to extended coordinates.
+ *
+ * With `X = y+x - (y-x) = 2x` and `Y = 2y` projectively over `Z = 2`, the
+ * extended point is `(XZ : YZ : Z² : XY)`, which costs one multiplication.
+ */
+void ristretto_affine_to_point(ristretto_point_t *out, const ristretto_affine_point_t *in)
+{
+  bignum25519 ALIGN(16) x, y;
+
+  curve25519_sub_reduce(x, in->point.xaddy, in->point.ysubx);
+  curve25519_add_reduce(y, in->point.xaddy, in->point.ysubx);
+
+  curve25519_mul(out->point.t, x, y);
+  curve25519_add_reduce(out->point.x, x, x);
+  curve25519_add_reduce(out->point.y, y, y);
+  memset(out->point.z, 0, sizeof(bignum25519));
+  out->point.z[0] = 4;
+}
+
+/**
+ * Compute `out = a + b` with a mixed addition, which saves the
+ * multiplication by `b`'s `Z`.
+ */
+void ristretto_add_affine(ristretto_point_t *out, const ristretto_point_t *a, const ristretto_affine_point_t *b)
+{
+  ge25519_p1p1 ALIGN(16) t;
+
+  ge25519_nielsadd2_p1p1(&t, &a->point, &b->point, 0);
+  ge25519_p1p1_to_full(&out->point, &t);
+}
+
+/**
+ * Per-point state for `ristretto_double_and_encode_batch()`.  For a point
+ * `P = (X:Y:Z:T)`, doubling and encoding only needs the completed-point
+ * coordinates of `2P`, i.e. `e/f` and `g/h`, and their products.
+ */
+typedef struct ristretto_batch_encode_state_s {
+  bignum25519 e, f, g, h, eg, fh;
+} ristretto_batch_encode_state_t;
+
+/**
+ * Encode `[2]P_i` for each of the `n` points in `pts` into `out[i]`.
+ *
+ * Encoding a single point requires an inverse square root.  Encoding the
+ * double of a point instead only requires an inverse, so all `n` encodings
+ * can share one field inversion via Montgomery's trick, plus roughly three
+ * multiplications per point.  Encodings of points which double to the
+ * identity are handled without disturbing the rest of the batch.
+ *
+ * Returns 1 on success and 0 if scratch space could not be allocated.
+ */
+int ristretto_double_and_encode_batch(unsigned char (*out)[32], const ristretto_point_t *pts, size_t n)
+{
+  ristretto_batch_encode_state_t *states;
+  bignum25519 *invs, *efgh;
+  bignum25519 ALIGN(16) xx, yy, zz, dtt, z_inv, t_inv;
+  bignum25519 ALIGN(16) e, g, h, magic, minus_e, f_sqrt_m1, tmp, s;
+  unsigned char contracted[32];
+  uint8_t negcheck1, negcheck2, s_is_negative;
+  size_t i;
+
+  if (n == 0) {
+    return 1;
+  }
+
+  states = (ristretto_batch_encode_state_t*)malloc(n * sizeof(ristretto_batch_encode_state_t));
+  invs = (bignum25519*)malloc(n * sizeof(bignum25519));
+  efgh = (bignum25519*)malloc(n * sizeof(bignum25519));
+
+  if (states == NULL || invs == NULL || efgh == NULL) {
+    free(states);
+    free(invs);
+    free(efgh);
+    return 0;
+  }
+
+  for (i = 0; i < n; i++) {
+    const ge25519 *p = &pts[i].point;
+    ristretto_batch_encode_state_t *st = &states[i];
+
+    curve25519_square(xx, p->x);
+    curve25519_square(yy, p->y);
+    curve25519_square(zz, p->z);
+    curve25519_square(dtt, p->t);
+    curve25519_mul(dtt, dtt, EDWARDS_D);       // dT²
+    curve25519_add_reduce(tmp, p->y, p->y);
+    curve25519_mul(st->e, p->x, tmp);         // e = 2XY
+    curve25519_add_reduce(st->f, zz, dtt);    // f = Z² + dT²
+    curve25519_add_reduce(st->g, yy, xx);     // g = Y² - aX², where a = -1
+    curve25519_sub_reduce(st->h, zz, dtt);    // h = Z² - dT²
+    curve25519_mul(st->eg, st->e, st->g);
+    curve25519_mul(st->fh, st->f, st->h);
+    curve25519_mul(efgh[i], st->eg, st->fh);
+  }
+
+  // efgh is zero only when 2P is the identity, where the inverse is
+  // irrelevant and zero gives the right encoding.
+  curve25519_batch_recip(invs, efgh, n);
+
+  for (i = 0; i < n; i++) {
+    const ristretto_batch_encode_state_t *st = &states[i];
+
+    curve25519_mul(z_inv, st->eg, invs[i]);   // 1/fh
+    curve25519_mul(t_inv, st->fh, invs[i]);   // 1/eg
+
+    curve25519_mul(tmp, st->eg, z_inv);       // T/Z of 2P
+    curve25519_contract(contracted, tmp);
+    negcheck1 = bignum25519_is_negative(contracted);
+
+    curve25519_copy(e, st->e);
+    curve25519_copy(g, st->g);
+    curve25519_copy(h, st->h);
+    curve25519_copy(magic, INVSQRT_A_MINUS_D);
+    curve25519_neg(minus_e, e);
+    curve25519_mul(f_sqrt_m1, st->f, SQRT_M1);
+
+    // Rotate into the distinguished Jacobi quartic quadrant
+    curve25519_copy(tmp, st->g);
+    curve25519_swap_conditional(e, tmp, negcheck1);
+    curve25519_swap_conditional(g, minus_e, negcheck1);
+    curve25519_swap_conditional(h, f_sqrt_m1, negcheck1);
+    curve25519_copy(tmp, SQRT_M1);
+    curve25519_swap_conditional(magic, tmp, negcheck1);
+
+    curve25519_mul(tmp, h, e);
+    curve25519_mul(tmp, tmp, z_inv);
+    curve25519_contract(contracted, tmp);
+    negcheck2 = bignum25519_is_negative(contracted);
+
+    curve25519_neg(tmp, g);
+    curve25519_swap_conditional(g, tmp, negcheck2);
+
+    // s = (h - g) * magic * g / eg
+    curve25519_mul(tmp, g, t_inv);
+    curve25519_mul(tmp, magic, tmp);
+    curve25519_sub_reduce(s, h, g);
+    curve25519_mul(s, s, tmp);
+
+    curve25519_contract(contracted, s);
+    s_is_negative = bignum25519_is_negative(contracted);
+    curve25519_neg(tmp, s);
+    curve25519_swap_conditional(s, tmp, s_is_negative);
+
+    curve25519_contract(out[i], s);
+  }
+
+  free(states);
+  free(invs);
+  free(efgh);
+
+  return 1;
+}
+
+/**
+ * First half of the Elligator map: decode `t` from `bytes` and compute
+ * `r = i*t²`, and `u` and `v` such that `sqrt(u/v)` is needed next.
+ */
+static void ristretto_elligator_map_prepare(bignum25519 t, bignum25519 r, bignum25519 u, bignum25519 v,
+                                            const unsigned char bytes[32])
+{
+  bignum25519 ALIGN(16) tmp, tmp2;
+  unsigned char t_bytes[32];
+
+  memcpy(t_bytes, bytes, 32);
+  t_bytes[31] &= 0x7f;
+  curve25519_expand(t, t_bytes);
+
+  curve25519_square(tmp, t);
+  curve25519_mul(r, SQRT_M1, tmp);                         // r = i*t²
+  curve25519_add_reduce(tmp, r, one);
+  curve25519_mul(u, tmp, ONE_MINUS_EDWARDS_D_SQUARED);     // u = (r+1)(1-d²)
+  curve25519_mul(tmp, r, EDWARDS_D);
+  curve25519_add_reduce(tmp, tmp, one);
+  curve25519_neg(tmp, tmp);                                // -1 - rd
+  curve25519_add_reduce(tmp2, r, EDWARDS_D);
+  curve25519_mul(v, tmp, tmp2);                            // v = (-1-rd)(r+d)
+}
+
+/**
+ * Second half of the Elligator map, given `s = sqrt_ratio_i(u, v)` and
+ * whether `u/v` was square.
+ */
+static void ristretto_elligator_map_finish(ge25519 *out,
+                                           const bignum25519 t, const bignum25519 r,
+                                           const bignum25519 v, const bignum25519 sqrt_uv,
+                                           uint8_t was_square)
+{
+  bignum25519 ALIGN(16) s, s_prime, c, n, w0, w1, w2, w3, tmp;
+  unsigned char contracted[32];
+  uint8_t is_negative;
+
+  curve25519_copy(s, sqrt_uv);
+
+  // s' = -|s*t|
+  curve25519_mul(s_prime, s, t);
+  curve25519_contract(contracted, s_prime);
+  is_negative = bignum25519_is_negative(contracted);
+  curve25519_neg(tmp, s_prime);
+  curve25519_swap_conditional(s_prime, tmp, is_negative ^ 1);
+
+  // s = s if u/v was square, otherwise s'
+  curve25519_swap_conditional(s, s_prime, was_square ^ 1);
+
+  // c = -1 if u/v was square, otherwise r
+  curve25519_copy(c, r);
+  curve25519_neg(tmp, one);
+  curve25519_swap_conditional(c, tmp, was_square);
+
+  curve25519_sub_reduce(tmp, r, one);
+  curve25519_mul(n, c, tmp);
+  curve25519_mul(n, n, EDWARDS_D_MINUS_ONE_SQUARED);
+  curve25519_sub_reduce(n, n, v);                          // N = c(r-1)(d-1)² - v
+
+  curve25519_add_reduce(tmp, s, s);
+  curve25519_mul(w0, tmp, v);                              // w0 = 2sv
+  curve25519_mul(w1, n, SQRT_AD_MINUS_ONE);                // w1 = N*sqrt(ad-1)
+  curve25519_square(tmp, s);
+  curve25519_sub_reduce(w2, one, tmp);                     // w2 = 1 - s²
+  curve25519_add_reduce(w3, one, tmp);                     // w3 = 1 + s²
+
+  curve25519_mul(out->x, w0, w3);
+  curve25519_mul(out->y, w2, w1);
+  curve25519_mul(out->z, w1, w3);
+  curve25519_mul(out->t, w0, w2);
+}
+
+/**
+ * Map 32 bytes to a point with the Ristretto flavour of Elligator, as
+ * specified by the MAP function of RFC 9496.  The high bit of `bytes` is
+ * ignored.
+ *
+ * This map is not uniform on its own, see `ristretto_from_uniform_bytes()`.
+ */
+void ristretto_elligator_map(ge25519 *out, const unsigned char bytes[32])
+{
+  bignum25519 ALIGN(16) t, r, u, v, s;
+  uint8_t was_square;
+
+  ristretto_elligator_map_prepare(t, r, u, v, bytes);
+  was_square = curve25519_sqrt_ratio_i(s, u, v);
+  ristretto_elligator_map_finish(out, t, r, v, s, was_square);
+}
+
+/**
+ * Derive a uniformly distributed point from 64 uniformly random bytes, by
+ * running the Elligator map on each half and adding the results.
+ */
+void ristretto_from_uniform_bytes(ristretto_point_t *out, const unsigned char bytes[64])
+{
+  ge25519 ALIGN(16) p1, p2;
+
+  ristretto_elligator_map(&p1, bytes);
+  ristretto_elligator_map(&p2, bytes + 32);
+  ge25519_add(&out->point, &p1, &p2);
+}
+
+/**
+ * Hash an arbitrary message to a point, by feeding its SHA-512 digest to
+ * `ristretto_from_uniform_bytes()`.
+ */
+void ristretto_hash_to_group(ristretto_point_t *out, const unsigned char *msg, size_t len)
+{
+  hash_512bits hash;
+
+  ed25519_hash(hash, msg, len);
+  ristretto_from_uniform_bytes(out, hash);
+}
+
+/**
+ * The number of field elements the batched functions push through an
+ * exponentiation side by side.  `ristretto_from_uniform_bytes_batch()` needs
+ * two per input, the batched codec one.
+ */
+#define RISTRETTO_BATCH_LANES 8
+
+/**
+ * Set `out[l] = in[l]^(2^count)` for each of `lanes` field elements, doing
+ * one squaring of every lane at a time.  Squarings of different lanes are
+ * independent, so this keeps the multiplier busy where a single chain of
+ * squarings would stall on each result.
+ */
+static void curve25519_square_times_lanes(bignum25519 *out, const bignum25519 *in, int count, size_t lanes)
+{
+  size_t l;
+  int i;
+
+  for (l = 0; l < lanes; l++) {
+    curve25519_square(out[l], in[l]);
+  }
+  for (i = 1; i < count; i++) {
+    for (l = 0; l < lanes; l++) {
+      curve25519_square(out[l], out[l]);
+    }
+  }
+}
+
+/**
+ * Set `out[l] = a[l] * b[l]` for each of `lanes` field elements.
+ */
+static void curve25519_mul_lanes(bignum25519 *out, const bignum25519 *a, const bignum25519 *b, size_t lanes)
+{
+  size_t l;
+
+  for (l = 0; l < lanes; l++) {
+    curve25519_mul(out[l], a[l], b[l]);
+  }
+}
+
+#if defined(ED25519_X4)
+/**
+ * Set `out = in^(2^count)` on each of the four packed field elements.
+ */
+CURVE25519X4_FN static void curve25519x4_square_times(bignum25519x4 out, const bignum25519x4 in, int count)
+{
+  int i;
+
+  curve25519x4_square(out, in);
+  for (i = 1; i < count; i++) {
+    curve25519x4_square(out, out);
+  }
+}
+
+/**
+ * `curve25519_pow_two252m3()` on each of the four packed field elements.
+ */
+CURVE25519X4_FN static void curve25519x4_pow_two252m3(bignum25519x4 out, const bignum25519x4 z)
+{
+  bignum25519x4 b, c, t0;
+
+  /* 2 */ curve25519x4_square_times(c, z, 1);
+  /* 8 */ curve25519x4_square_times(t0, c, 2);
+  /* 9 */ curve25519x4_mul(b, t0, z);
+  /* 11 */ curve25519x4_mul(c, b, c);
+  /* 22 */ curve25519x4_square_times(t0, c, 1);
+  /* 2^5 - 2^0 = 31 */ curve25519x4_mul(b, t0, b);
+  /* 2^10 - 2^5 */ curve25519x4_square_times(t0, b, 5);
+  /* 2^10 - 2^0 */ curve25519x4_mul(b, t0, b);
+  /* 2^20 - 2^10 */ curve25519x4_square_times(t0, b, 10);
+  /* 2^20 - 2^0 */ curve25519x4_mul(c, t0, b);
+  /* 2^40 - 2^20 */ curve25519x4_square_times(t0, c, 20);
+  /* 2^40 - 2^0 */ curve25519x4_mul(t0, t0, c);
+  /* 2^50 - 2^10 */ curve25519x4_square_times(t0, t0, 10);
+  /* 2^50 - 2^0 */ curve25519x4_mul(b, t0, b);
+  /* 2^100 - 2^50 */ curve25519x4_square_times(t0, b, 50);
+  /* 2^100 - 2^0 */ curve25519x4_mul(c, t0, b);
+  /* 2^200 - 2^100 */ curve25519x4_square_times(t0, c, 100);
+  /* 2^200 - 2^0 */ curve25519x4_mul(t0, t0, c);
+  /* 2^250 - 2^50 */ curve25519x4_square_times(t0, t0, 50);
+  /* 2^250 - 2^0 */ curve25519x4_mul(b, t0, b);
+  /* 2^252 - 2^2 */ curve25519x4_square_times(b, b, 2);
+  /* 2^252 - 3 */ curve25519x4_mul(out, b, z);
+}
+
+/**
+ * `curve25519_pow_two252m3_lanes()` on the 4-way field arithmetic, four
+ * lanes at a time.  The unused lanes of a short last group repeat its last
+ * element.
+ */
+CURVE25519X4_FN static void curve25519_pow_two252m3_lanes_x4(bignum25519 *out, const bignum25519 *z, size_t lanes)
+{
+  bignum25519x4 packed, result;
+  bignum25519 ALIGN(16) unpacked[4];
+  size_t l, k, last = lanes - 1;
+
+  for (l = 0; l < lanes; l += 4) {
+    curve25519x4_pack(packed, z[l],
+                      z[(l + 1 < lanes) ? l + 1 : last],
+                      z[(l + 2 < lanes) ? l + 2 : last],
+                      z[(l + 3 < lanes) ? l + 3 : last]);
+    curve25519x4_pow_two252m3(result, packed);
+    curve25519x4_unpack(unpacked[0], unpacked[1], unpacked[2], unpacked[3], result);
+
+    for (k = 0; k < 4 && l + k < lanes; k++) {
+      curve25519_copy(out[l + k], unpacked[k]);
+    }
+  }
+}
+#endif
+
+/**
+ * Interleaved `curve25519_pow_two252m3()`, i.e. `out[l] = z[l]^((p-5)/8)`,
+ * for up to `RISTRETTO_BATCH_LANES` field elements.
+ */
+static void curve25519_pow_two252m3_lanes(bignum25519 *out, const bignum25519 *z, size_t lanes)
+{
+  bignum25519 ALIGN(16) b[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) c[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) t0[RISTRETTO_BATCH_LANES];
+
+#if defined(ED25519_X4)
+  if (curve25519x4_available()) {
+    curve25519_pow_two252m3_lanes_x4(out, z, lanes);
+    return;
+  }
+#endif
+
+  /* 2 */ curve25519_square_times_lanes(c, z, 1, lanes);
+  /* 8 */ curve25519_square_times_lanes(t0, c, 2, lanes);
+  /* 9 */ curve25519_mul_lanes(b, t0, z, lanes);
+  /* 11 */ curve25519_mul_lanes(c, b, c, lanes);
+  /* 22 */ curve25519_square_times_lanes(t0, c, 1, lanes);
+  /* 2^5 - 2^0 = 31 */ curve25519_mul_lanes(b, t0, b, lanes);
+  /* 2^10 - 2^5 */ curve25519_square_times_lanes(t0, b, 5, lanes);
+  /* 2^10 - 2^0 */ curve25519_mul_lanes(b, t0, b, lanes);
+  /* 2^20 - 2^10 */ curve25519_square_times_lanes(t0, b, 10, lanes);
+  /* 2^20 - 2^0 */ curve25519_mul_lanes(c, t0, b, lanes);
+  /* 2^40 - 2^20 */ curve25519_square_times_lanes(t0, c, 20, lanes);
+  /* 2^40 - 2^0 */ curve25519_mul_lanes(t0, t0, c, lanes);
+  /* 2^50 - 2^10 */ curve25519_square_times_lanes(t0, t0, 10, lanes);
+  /* 2^50 - 2^0 */ curve25519_mul_lanes(b, t0, b, lanes);
+  /* 2^100 - 2^50 */ curve25519_square_times_lanes(t0, b, 50, lanes);
+  /* 2^100 - 2^0 */ curve25519_mul_lanes(c, t0, b, lanes);
+  /* 2^200 - 2^100 */ curve25519_square_times_lanes(t0, c, 100, lanes);
+  /* 2^200 - 2^0 */ curve25519_mul_lanes(t0, t0, c, lanes);
+  /* 2^250 - 2^50 */ curve25519_square_times_lanes(t0, t0, 50, lanes);
+  /* 2^250 - 2^0 */ curve25519_mul_lanes(b, t0, b, lanes);
+  /* 2^252 - 2^2 */ curve25519_square_times_lanes(b, b, 2, lanes);
+  /* 2^252 - 3 */ curve25519_mul_lanes(out, b, z, lanes);
+}
+
+/**
+ * Compute `ristretto_from_uniform_bytes()` for each of the `n` 64-byte
+ * `inputs`, storing the results in `out`.
+ *
+ * Inputs are processed in groups, with the Elligator maps of a group
+ * evaluated side by side.  In particular the exponentiations inside
+ * `curve25519_sqrt_ratio_i()`, which dominate the cost of the map, are
+ * interleaved squaring by squaring.  All scratch space lives on the stack
+ * and is reused from one group to the next.
+ */
+void ristretto_from_uniform_bytes_batch(ristretto_point_t *out, const unsigned char (*inputs)[64], size_t n)
+{
+  bignum25519 ALIGN(16) t[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) r[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) u[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) v[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) v3[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) uv7[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) pow[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) s;
+  ge25519 ALIGN(16) points[RISTRETTO_BATCH_LANES];
+  uint8_t was_square;
+  size_t done, group, lanes, l;
+
+  for (done = 0; done < n; done += group) {
+    group = n - done;
+    if (group > RISTRETTO_BATCH_LANES / 2) {
+      group = RISTRETTO_BATCH_LANES / 2;
+    }
+    lanes = group * 2;
+
+    // Lane 2i holds the first half of input i, and lane 2i+1 the second.
+    for (l = 0; l < lanes; l++) {
+      ristretto_elligator_map_prepare(t[l], r[l], u[l], v[l], inputs[done + l/2] + 32*(l & 1));
+      curve25519_sqrt_ratio_i_prepare(uv7[l], v3[l], u[l], v[l]);
+    }
+
+    curve25519_pow_two252m3_lanes(pow, uv7, lanes);
+
+    for (l = 0; l < lanes; l++) {
+      was_square = curve25519_sqrt_ratio_i_finish(s, u[l], v[l], v3[l], pow[l]);
+      ristretto_elligator_map_finish(&points[l], t[l], r[l], v[l], s, was_square);
+    }
+
+    for (l = 0; l < group; l++) {
+      ge25519_add(&out[done + l].point, &points[2*l], &points[2*l + 1]);
+    }
+  }
+}
+
+/**
+ * Decode each of the `n` encodings in `bytes` into `out`, setting `valid[i]`
+ * to 1 if `bytes[i]` decoded and to 0 otherwise.  As with
+ * `ristretto_decode()`, elements of `out` whose encoding was invalid are
+ * left untouched, and they do not affect the rest of the batch.
+ *
+ * Encodings are processed in groups of `RISTRETTO_BATCH_LANES`, with the
+ * inverse square roots of a group computed side by side, four lanes wide on
+ * the 4-way field arithmetic where the cpu supports it.
+ *
+ * Returns 1 if every element decoded and 0 otherwise.
+ */
+int ristretto_decode_batch(ristretto_point_t *out, const unsigned char (*bytes)[32], size_t n, int *valid)
+{
+  bignum25519 ALIGN(16) s[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) u1[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) u2[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) v[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) w[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) v3[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) uv7[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) pow[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) i;
+  uint8_t s_ok[RISTRETTO_BATCH_LANES];
+  uint8_t ok;
+  size_t done, lanes, l;
+  int all_valid = 1;
+
+  for (done = 0; done < n; done += lanes) {
+    lanes = n - done;
+    if (lanes > RISTRETTO_BATCH_LANES) {
+      lanes = RISTRETTO_BATCH_LANES;
+    }
+
+    // An invalid encoding of s still yields field elements, so its lane
+    // runs with the others and is only discarded at the end.
+    for (l = 0; l < lanes; l++) {
+      s_ok[l] = ristretto_decode_prepare(s[l], u1[l], u2[l], v[l], w[l], bytes[done + l]);
+      curve25519_sqrt_ratio_i_prepare(uv7[l], v3[l], one, w[l]);
+    }
+
+    curve25519_pow_two252m3_lanes(pow, uv7, lanes);
+
+    for (l = 0; l < lanes; l++) {
+      ok = curve25519_sqrt_ratio_i_finish(i, one, w[l], v3[l], pow[l]);
+      valid[done + l] = ristretto_decode_finish(&out[done + l], s[l], u1[l], u2[l], v[l], i, ok & s_ok[l]);
+      all_valid &= valid[done + l];
+    }
+  }
+
+  return all_valid;
+}
+
+/**
+ * Encode each of the `n` points in `pts` into `out[i]`, processing them in
+ * groups like `ristretto_decode_batch()`.
+ */
+void ristretto_encode_batch(unsigned char (*out)[32], const ristretto_point_t *pts, size_t n)
+{
+  bignum25519 ALIGN(16) u1[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) u2[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) w[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) v3[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) uv7[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) pow[RISTRETTO_BATCH_LANES];
+  bignum25519 ALIGN(16) invsqrt;
+  size_t done, lanes, l;
+
+  for (done = 0; done < n; done += lanes) {
+    lanes = n - done;
+    if (lanes > RISTRETTO_BATCH_LANES) {
+      lanes = RISTRETTO_BATCH_LANES;
+    }
+
+    for (l = 0; l < lanes; l++) {
+      ristretto_encode_prepare(u1[l], u2[l], w[l], &pts[done + l]);
+      curve25519_sqrt_ratio_i_prepare(uv7[l], v3[l], one, w[l]);
+    }
+
+    curve25519_pow_two252m3_lanes(pow, uv7, lanes);
+
+    // w is always square, see ristretto_encode()
+    for (l = 0; l < lanes; l++) {
+      curve25519_sqrt_ratio_i_finish(invsqrt, one, w[l], v3[l], pow[l]);
+      ristretto_encode_finish(out[done + l], &pts[done + l], u1[l], u2[l], invsqrt);
+    }
+  }
+}
+
+/**
+ * Interpret `bytes` as a little-endian integer and reduce it modulo `l`.
+ */
+void ristretto_scalar_from_bytes_mod_order(ristretto_scalar_t *out, const unsigned char bytes[32])
+{
+  expand256_modm(out->scalar, bytes, 32);
+}
+
+/**
+ * Interpret 64 `bytes` as a little-endian integer and reduce it modulo `l`
+ * with a single Barrett reduction.
+ *
+ * With uniformly random input, e.g. a SHA-512 digest, the result is
+ * indistinguishable from a uniformly random scalar.
+ */
+void ristretto_scalar_from_bytes_mod_order_wide(ristretto_scalar_t *out, const unsigned char bytes[64])
+{
+  expand256_modm(out->scalar, bytes, 64);
+}
+
+/**
+ * Encode `s` as 32 little-endian bytes.
+ */
+void ristretto_scalar_to_bytes(unsigned char bytes[32], const ristretto_scalar_t *s)
+{
+  contract256_modm(bytes, s->scalar);
+}
+
+/**
+ * Compute `out = a + b (mod l)`.
+ */
+void ristretto_scalar_add(ristretto_scalar_t *out, const ristretto_scalar_t *a, const ristretto_scalar_t *b)
+{
+  add256_modm(out->scalar, a->scalar, b->scalar);
+}
+
+/**
+ * Compute `out = a - b (mod l)`.
+ */
+void ristretto_scalar_sub(ristretto_scalar_t *out, const ristretto_scalar_t *a, const ristretto_scalar_t *b)
+{
+  sub256_modm(out->scalar, a->scalar, b->scalar);
+}
+
+/**
+ * Compute `out = -a (mod l)`.
+ */
+void ristretto_scalar_neg(ristretto_scalar_t *out, const ristretto_scalar_t *a)
+{
+  bignum256modm zero = {0};
+
+  sub256_modm(out->scalar, zero, a->scalar);
+}
+
+/**
+ * Compute `out = a * b (mod l)`.
+ */
+void ristretto_scalar_mul(ristretto_scalar_t *out, const ristretto_scalar_t *a, const ristretto_scalar_t *b)
+{
+  mul256_modm(out->scalar, a->scalar, b->scalar);
+}
+
+/**
+ * Compute `out = 1/a (mod l)` in constant time, as `a^(l-2)`.
+ *
+ * The exponent is evaluated with a fixed addition chain of 250 squarings
+ * and 34 multiplications, taken from
+ * https://briansmith.org/ecc-inversion-addition-chains-01, so it costs about
+ * half of a generic square-and-multiply.  The inverse of zero is zero.
+ */
+void ristretto_scalar_invert(ristretto_scalar_t *out, const ristretto_scalar_t *a)
+{
+  // Each step of the chain is y = y^(2^squarings) * a^power
+  static const struct {
+    unsigned char squarings;
+    unsigned char power;
+  } chain[27] = {
+    {126, 5}, {4, 3}, {5, 15}, {5, 15}, {4, 9}, {2, 3}, {5, 15}, {4, 5},
+    {6, 5}, {3, 7}, {5, 15}, {5, 7}, {4, 3}, {5, 11}, {6, 11}, {10, 9},
+    {4, 3}, {5, 3}, {5, 3}, {5, 9}, {4, 7}, {6, 15}, {5, 11}, {3, 5},
+    {6, 15}, {3, 5}, {3, 3},
+  };
+  // pow[i] = a^(2i+1); a^13 is never used and is left unset
+  bignum256modm pow[8], a2, a4, y;
+  int i, j;
+
+  mul256_modm(a2, a->scalar, a->scalar);
+  mul256_modm(a4, a2, a2);
+
+  memcpy(pow[0], a->scalar, sizeof(bignum256modm));
+  mul256_modm(pow[1], a2, pow[0]);
+  mul256_modm(pow[2], a2, pow[1]);
+  mul256_modm(pow[3], a2, pow[2]);
+  mul256_modm(pow[4], a2, pow[3]);
+  mul256_modm(pow[5], a2, pow[4]);
+  mul256_modm(pow[7], a4, pow[5]);
+
+  // y = a^16
+  mul256_modm(y, pow[7], pow[0]);
+
+  for (i = 0; i < 27; i++) {
+    for (j = 0; j < chain[i].squarings; j++) {
+      mul256_modm(y, y, y);
+    }
+    mul256_modm(y, y, pow[chain[i].power / 2]);
+  }
+
+  memcpy(out->scalar, y, sizeof(bignum256modm));
+}
+
+/**
+ * Set `out = in` if `flag` is 1, and leave `out` alone if it is 0, in
+ * constant time.
+ */
+static void bignum256modm_move_conditional(bignum256modm out, const bignum256modm in, uint8_t flag)
+{
+  const bignum256modm_element_t mask = (bignum256modm_element_t)0 - flag;
+  int i;
+
+  for (i = 0; i < bignum256modm_limb_size; i++) {
+    out[i] ^= mask & (out[i] ^ in[i]);
+  }
+}
+
+/**
+ * Load `s` into `out`, substituting one if `s` is zero, and return 1 if `s`
+ * was zero.  This keeps a zero from poisoning a batched inversion.
+ */
+static uint8_t ristretto_scalar_nonzero(bignum256modm out, const ristretto_scalar_t *s)
+{
+  static const unsigned char zero[32] = {0};
+  bignum256modm one = {1};
+  unsigned char bytes[32];
+  uint8_t is_zero;
+
+  contract256_modm(bytes, s->scalar);
+  is_zero = uint8_32_ct_eq(bytes, zero);
+
+  memcpy(out, s->scalar, sizeof(bignum256modm));
+  bignum256modm_move_conditional(out, one, is_zero);
+
+  return is_zero;
+}
+
+/**
+ * Replace each of the `n` `scalars` with its inverse modulo `l`, using
+ * Montgomery's trick: a single `ristretto_scalar_invert()` and `3(n-1)`
+ * multiplications.  `scratch` must hold `n` scalars.
+ *
+ * This runs in constant time.  As with `ristretto_scalar_invert()`, zero
+ * inputs are mapped to zero, without affecting the rest of the batch.
+ */
+void ristretto_scalar_batch_invert(ristretto_scalar_t *scalars, size_t n, ristretto_scalar_t *scratch)
+{
+  bignum256modm s, t;
+  bignum256modm zero = {0};
+  ristretto_scalar_t inv;
+  uint8_t is_zero;
+  size_t i;
+
+  if (n == 0) {
+    return;
+  }
+
+  // scratch[i] = s_0 * ... * s_i
+  ristretto_scalar_nonzero(scratch[0].scalar, &scalars[0]);
+  for (i = 1; i < n; i++) {
+    ristretto_scalar_nonzero(s, &scalars[i]);
+    mul256_modm(scratch[i].scalar, scratch[i-1].scalar, s);
+  }
+
+  ristretto_scalar_invert(&inv, &scratch[n-1]);
+
+  // inv = 1/(s_0 * ... * s_i) on entry to each iteration
+  for (i = n - 1; i > 0; i--) {
+    is_zero = ristretto_scalar_nonzero(s, &scalars[i]);
+    mul256_modm(t, inv.scalar, scratch[i-1].scalar);
+    mul256_modm(inv.scalar, inv.scalar, s);
+
+    bignum256modm_move_conditional(t, zero, is_zero);
+    memcpy(scalars[i].scalar, t, sizeof(bignum256modm));
+  }
+
+  is_zero = ristretto_scalar_nonzero(s, &scalars[0]);
+  bignum256modm_move_conditional(inv.scalar, zero, is_zero);
+  memcpy(scalars[0].scalar, inv.scalar, sizeof(bignum256modm));
+}
@@ -9,11 +9,6 @@
 #define RISTRETTO_DONNA_H
 
 #include "ed25519-donna.h"
-#if defined(ED25519_64BIT)
-#include "ed25519-donna-64bit-tables.h"
-#else
-#include "ed25519-donna-32bit-tables.h"
-#endif
 #include "ristretto-utils.h"
 
 #if defined(__cplusplus)
@@ -22,17 +17,26 @@ extern "C" {
 
 /**
  * A `ristretto_point_t` internally holds an Edwards point in extended twisted
- * Edwards coordinates.
+ * Edwards coordinates.  It is 16-byte aligned, which the SSE2 backend needs
+ * and which costs nothing elsewhere since a `ge25519` is a multiple of 16
+ * bytes on every backend.
  */
 typedef struct ristretto_point_s {
-  ge25519 point;
+  ge25519 ALIGN(16) point;
 } ristretto_point_t;
 
+/*
+ * The SSE2 backend loads and stores field elements as whole `xmm` registers,
+ * so every `bignum25519` it touches must be 16-byte aligned.  The constants
+ * below are aligned unconditionally, and under `ED25519_SSE2` the layout is
+ * the 10-limb one of the 32-bit backend padded to 12 words.
+ */
+
 /**
  * Edwards `d` value from the curve equation, equal to `-121665/121666 (mod p)`.
  */
 #if defined(ED25519_64BIT)
-const bignum25519 EDWARDS_D = {
+const bignum25519 ALIGN(16) EDWARDS_D = {
     929955233495203,
     466365720129213,
     1662059464998953,
@@ -40,7 +44,7 @@ const bignum25519 EDWARDS_D = {
     1442794654840575,
 };
 #else
-const bignum25519 EDWARDS_D = {
+const bignum25519 ALIGN(16) EDWARDS_D = {
     56195235, 13857412, 51736253,  6949390,   114729,
     24766616, 60832955, 30306712, 48412415, 21499315,
 };
@@ -50,7 +54,7 @@ const bignum25519 EDWARDS_D = {
  * Precomputed value of one of the square roots of -1 (mod p)
  */
 #if defined(ED25519_64BIT)
-const bignum25519 SQRT_M1 = {
+const bignum25519 ALIGN(16) SQRT_M1 = {
     1718705420411056,
     234908883556509,
     2233514472574048,
@@ -58,22 +62,34 @@ const bignum25519 SQRT_M1 = {
     765476049583133,
 };
 #else
-const bignum25519 SQRT_M1 = {
+const bignum25519 ALIGN(16) SQRT_M1 = {
     34513072, 25610706,  9377949, 3500415, 12389472,
     33281959, 41962654, 31548777,  326685, 11406482,
 };
 #endif
 
+/**
+ * `1` and `p - 1 = -1 (mod p)`.
+ */
 #if defined(ED25519_64BIT)
-const bignum25519 one = {1, 0, 0, 0, 0};
-const bignum25519 negative_one = {-1, 0, 0, 0, 0};
+const bignum25519 ALIGN(16) one = {1, 0, 0, 0, 0};
+const bignum25519 ALIGN(16) negative_one = {
+  2251799813685228,
+  2251799813685247,
+  2251799813685247,
+  2251799813685247,
+  2251799813685247,
+};
 #else
-const bignum25519 one = {1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-const bignum25519 negative_one = {-1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+const bignum25519 ALIGN(16) one = {1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+const bignum25519 ALIGN(16) negative_one = {
+  67108844, 33554431, 67108863, 33554431, 67108863,
+  33554431, 67108863, 33554431, 67108863, 33554431,
+};
 #endif
 
 #if defined(ED25519_64BIT)
-const bignum25519 INVSQRT_A_MINUS_D = {
+const bignum25519 ALIGN(16) INVSQRT_A_MINUS_D = {
   278908739862762,
   821645201101625,
   8113234426968,
@@ -81,12 +97,66 @@ const bignum25519 INVSQRT_A_MINUS_D = {
   2118520810568447,
 };
 #else
-const bignum25519 INVSQRT_A_MINUS_D = {
+const bignum25519 ALIGN(16) INVSQRT_A_MINUS_D = {
   6111466,  4156064, 39310137, 12243467, 41204824,
   120896, 20826367, 26493656,  6093567, 31568420,
 };
 #endif
 
+/**
+ * `1 - d²`, used in the Elligator map.
+ */
+#if defined(ED25519_64BIT)
+const bignum25519 ALIGN(16) ONE_MINUS_EDWARDS_D_SQUARED = {
+  1136626929484150,
+  1998550399581263,
+  496427632559748,
+  118527312129759,
+  45110755273534,
+};
+#else
+const bignum25519 ALIGN(16) ONE_MINUS_EDWARDS_D_SQUARED = {
+  6275446, 16937061, 44170319, 29780721, 11667076,
+  7397348, 39186143,  1766194, 42675006,   672202,
+};
+#endif
+
+/**
+ * `(d - 1)²`, used in the Elligator map.
+ */
+#if defined(ED25519_64BIT)
+const bignum25519 ALIGN(16) EDWARDS_D_MINUS_ONE_SQUARED = {
+  1507062230895904,
+  1572317787530805,
+  683053064812840,
+  317374165784489,
+  1572899562415810,
+};
+#else
+const bignum25519 ALIGN(16) EDWARDS_D_MINUS_ONE_SQUARED = {
+  15551776, 22456977, 53683765, 23429360, 55212328,
+  10178283, 40474537,  4729243, 61826754, 23438029,
+};
+#endif
+
+/**
+ * `sqrt(a*d - 1)`, where `a = -1`, used in the Elligator map.
+ */
+#if defined(ED25519_64BIT)
+const bignum25519 ALIGN(16) SQRT_AD_MINUS_ONE = {
+  2241493124984347,
+  425987919032274,
+  2207028919301688,
+  1220490630685848,
+  974799131293748,
+};
+#else
+const bignum25519 ALIGN(16) SQRT_AD_MINUS_ONE = {
+  24849947, 33400850, 43495378,  6347714, 46036536,
+  32887293, 41837720, 18186727, 66238516, 14525638,
+};
+#endif
+
 /**
  * The Ristretto basepoint in compressed form.
  */
@@ -102,15 +172,110 @@ const unsigned char RISTRETTO_BASEPOINT_COMPRESSED[32] = {
  */
 const ristretto_point_t RISTRETTO_BASEPOINT_POINT = {ge25519_basepoint};
 
+/**
+ * A `ristretto_affine_point_t` holds an Edwards point normalized to `Z = 1`,
+ * stored as `(y-x, y+x, 2dxy)`.  It takes three quarters of the space of a
+ * `ristretto_point_t`, and adding one to a `ristretto_point_t` costs one
+ * field multiplication less than adding two `ristretto_point_t`s.
+ *
+ * Only the SSE2 backend needs it aligned; elsewhere the alignment would pad
+ * the 120-byte point to 128 bytes.
+ */
+typedef struct ristretto_affine_point_s {
+#if defined(ED25519_SSE2)
+  ge25519_niels ALIGN(16) point;
+#else
+  ge25519_niels point;
+#endif
+} ristretto_affine_point_t;
+
+/**
+ * A `ristretto_scalar_t` is an integer modulo the group order
+ * `l = 2^252 + 27742317777372353535851937790883648493`, always kept fully
+ * reduced.
+ */
+typedef struct ristretto_scalar_s {
+  bignum256modm scalar;
+} ristretto_scalar_t;
+
+/**
+ * A precomputed table of multiples of a fixed point `P`, in the same layout
+ * as `ge25519_niels_base_multiples`: entry `8*i + j` holds `[(j+1)*256^i]P`
+ * as packed `(y-x, y+x, 2dxy)` affine Niels coordinates.
+ *
+ * The table is 24KiB and must be 16-byte aligned; heap allocations from
+ * `malloc()` are suitably aligned on all supported platforms.
+ */
+typedef struct ristretto_basepoint_table_s {
+  uint8_t ALIGN(16) table[256][96];
+} ristretto_basepoint_table_t;
+
+/**
+ * Serialized basepoint tables are a 64-byte header followed by the 24KiB
+ * table, so that a file holding one can be `mmap()`ed and used in place.
+ *
+ * All header fields are little-endian:
+ *
+ *   offset  size  field
+ *        0     8  magic, "r255tbl\0"
+ *        8     4  format version, RISTRETTO_TABLE_VERSION
+ *       12     4  backend which wrote the table, RISTRETTO_TABLE_BACKEND_*
+ *       16     4  window size in bits, 4 for radix-16 tables
+ *       20     4  number of entries, 256
+ *       24     4  size of each entry in bytes, 96
+ *       28     4  reserved, zero
+ *       32    32  first half of the SHA-512 digest of the table
+ *
+ * Table entries hold packed field elements rather than limbs, so a table is
+ * valid under every backend; the backend is only recorded for provenance.
+ */
+#define RISTRETTO_TABLE_HEADER_SIZE 64
+#define RISTRETTO_TABLE_SERIALIZED_SIZE (RISTRETTO_TABLE_HEADER_SIZE + sizeof(ristretto_basepoint_table_t))
+#define RISTRETTO_TABLE_VERSION 1
+
+#define RISTRETTO_TABLE_BACKEND_32BIT 1
+#define RISTRETTO_TABLE_BACKEND_64BIT 2
+#define RISTRETTO_TABLE_BACKEND_SSE2  3
+
 int ristretto_decode(ristretto_point_t *element, const unsigned char bytes[32]);
 void ristretto_encode(unsigned char bytes[32], const ristretto_point_t *element);
+int ristretto_decode_batch(ristretto_point_t *out, const unsigned char (*bytes)[32], size_t n, int *valid);
+void ristretto_encode_batch(unsigned char (*out)[32], const ristretto_point_t *pts, size_t n);
 int ristretto_ct_eq(const ristretto_point_t *a, const ristretto_point_t *b);
+void ristretto_scalarmult(ristretto_point_t *out, const ristretto_point_t *p, const unsigned char scalar[32]);
+void ristretto_scalarmult_base(ristretto_point_t *out, const unsigned char scalar[32]);
+void ristretto_double_scalarmult_vartime(ristretto_point_t *out, const ristretto_point_t *p, const bignum256modm a, const bignum256modm b);
+int ristretto_multiscalar_mul_vartime(ristretto_point_t *out, const ristretto_point_t *points, const bignum256modm *scalars, size_t n);
+int ristretto_double_and_encode_batch(unsigned char (*out)[32], const ristretto_point_t *pts, size_t n);
+void ristretto_from_uniform_bytes(ristretto_point_t *out, const unsigned char bytes[64]);
+void ristretto_from_uniform_bytes_batch(ristretto_point_t *out, const unsigned char (*inputs)[64], size_t n);
+void ristretto_hash_to_group(ristretto_point_t *out, const unsigned char *msg, size_t len);
+void ristretto_basepoint_table_create(ristretto_basepoint_table_t *table, const ristretto_point_t *p);
+void ristretto_basepoint_table_mul(ristretto_point_t *out, const ristretto_basepoint_table_t *table, const unsigned char scalar[32]);
+int ristretto_batch_normalize(ristretto_affine_point_t *out, const ristretto_point_t *in, size_t n);
+void ristretto_affine_to_point(ristretto_point_t *out, const ristretto_affine_point_t *in);
+void ristretto_add_affine(ristretto_point_t *out, const ristretto_point_t *a, const ristretto_affine_point_t *b);
+void ristretto_scalar_from_bytes_mod_order(ristretto_scalar_t *out, const unsigned char bytes[32]);
+void ristretto_scalar_from_bytes_mod_order_wide(ristretto_scalar_t *out, const unsigned char bytes[64]);
+void ristretto_scalar_to_bytes(unsigned char bytes[32], const ristretto_scalar_t *s);
+void ristretto_scalar_add(ristretto_scalar_t *out, const ristretto_scalar_t *a, const ristretto_scalar_t *b);
+void ristretto_scalar_sub(ristretto_scalar_t *out, const ristretto_scalar_t *a, const ristretto_scalar_t *b);
+void ristretto_scalar_neg(ristretto_scalar_t *out, const ristretto_scalar_t *a);
+void ristretto_scalar_mul(ristretto_scalar_t *out, const ristretto_scalar_t *a, const ristretto_scalar_t *b);
+void ristretto_scalar_invert(ristretto_scalar_t *out, const ristretto_scalar_t *a);
+void ristretto_scalar_batch_invert(ristretto_scalar_t *scalars, size_t n, ristretto_scalar_t *scratch);
+int ristretto_basepoint_table_store(unsigned char *out, size_t outlen, const ristretto_basepoint_table_t *table);
+int ristretto_basepoint_table_load(const ristretto_basepoint_table_t **table, const unsigned char *in, size_t inlen);
 
 #ifdef RISTRETTO_DONNA_PRIVATE
+uint8_t curve25519_sqrt_ratio_i(bignum25519 out, const bignum25519 u, const bignum25519 v);
 uint8_t curve25519_invsqrt(bignum25519 out, const bignum25519 v);
+void ristretto_elligator_map(ge25519 *out, const unsigned char bytes[32]);
 uint8_t uint8_32_ct_eq(const unsigned char a[32], const unsigned char b[32]);
 uint8_t bignum25519_ct_eq(const bignum25519 a, const bignum25519 b);
 void ge25519_pack_without_parity(unsigned char bytes[32], const ge25519 *p);
+int ristretto_multiscalar_mul_straus_vartime(ristretto_point_t *out, const ristretto_point_t *points, const bignum256modm *scalars, size_t n);
+int ristretto_multiscalar_mul_pippenger_vartime(ristretto_point_t *out, const ristretto_point_t *points, const bignum256modm *scalars, size_t n);
 #endif // RISTRETTO_DONNA_PRIVATE
 
 #if defined(__cplusplus)
@@ -158,6 +158,124 @@ test_subs() {
 	return 0;
 }
 
+/* carry 16 bit digits t[0..n-1] into t[n] */
+static void
+reference_carry(uint64_t *t, size_t n) {
+	size_t i;
+	for (i = 0; i < n; i++) {
+		t[i + 1] += t[i] >> 16;
+		t[i] &= 0xffff;
+	}
+}
+
+/* a * b mod 2^255-19 on 16 bit digits of the packed bytes, independent of the field code being tested */
+static void
+reference_mul(unsigned char out[32], const unsigned char a[32], const unsigned char b[32]) {
+	uint64_t t[33] = {0}, s[17], x[16], y[16];
+	size_t i, j, pass;
+
+	for (i = 0; i < 16; i++) {
+		x[i] = a[2 * i] | ((uint64_t)a[2 * i + 1] << 8);
+		y[i] = b[2 * i] | ((uint64_t)b[2 * i + 1] << 8);
+	}
+	for (i = 0; i < 16; i++)
+		for (j = 0; j < 16; j++)
+			t[i + j] += x[i] * y[j];
+
+	/* 2^256 = 38, fold the upper half down until it is gone */
+	for (pass = 0; pass < 3; pass++) {
+		reference_carry(t, 32);
+		for (i = 16; i < 33; i++) {
+			t[i - 16] += t[i] * 38;
+			t[i] = 0;
+		}
+	}
+	reference_carry(t, 15);
+
+	/* 2^255 = 19 */
+	for (pass = 0; pass < 2; pass++) {
+		t[0] += (t[15] >> 15) * 19;
+		t[15] &= 0x7fff;
+		reference_carry(t, 15);
+	}
+
+	/* t >= p exactly when t + 19 reaches 2^255 */
+	memcpy(s, t, 16 * sizeof(uint64_t));
+	s[0] += 19;
+	reference_carry(s, 15);
+	if (s[15] >> 15) {
+		s[15] &= 0x7fff;
+		memcpy(t, s, 16 * sizeof(uint64_t));
+	}
+
+	for (i = 0; i < 16; i++) {
+		out[2 * i] = (unsigned char)t[i];
+		out[2 * i + 1] = (unsigned char)(t[i] >> 8);
+	}
+}
+
+static int
+test_mul_reference() {
+#if defined(HAVE_UINT128) && !defined(ED25519_SSE2)
+	/* largest result for each limb from a mult or square, all limbs are carried once more in parallel */
+	static const bignum25519 max_bignum = {
+		0x800000003ffff,0x800000003ffff,0x800000003ffff,0x800000003ffff,0x800000003ffff
+	};
+#else
+	static const bignum25519 ALIGN(16) max_bignum = {
+		0x3ffffff,0x2000300,0x3ffffff,0x1ffffff,0x3ffffff,
+		0x1ffffff,0x3ffffff,0x1ffffff,0x3ffffff,0x1ffffff
+	};
+#endif
+	static const bignum25519 ALIGN(16) zero = {0};
+	unsigned char bytes[32], ra[32], rb[32], want[32], got[32];
+	bignum25519 ALIGN(16) in[8], a, b, c;
+	uint32_t seed = 1;
+	size_t i, j, k;
+
+	/* unreduced inputs as the point formulas produce them, then random ones */
+	curve25519_copy(in[0], max_bignum);
+	curve25519_add(in[1], max_bignum, max_bignum);
+	curve25519_add_after_basic(in[2], in[1], max_bignum);
+	curve25519_sub_after_basic(in[3], max_bignum, zero);
+	curve25519_sub(in[4], zero, max_bignum);
+	for (i = 5; i < 8; i++) {
+		for (j = 0; j < 32; j++) {
+			seed = seed * 1103515245 + 12345;
+			bytes[j] = (unsigned char)(seed >> 16);
+		}
+		curve25519_expand(in[i], bytes);
+	}
+
+	for (i = 0; i < 8; i++) {
+		curve25519_contract(ra, in[i]);
+		for (j = 0; j < 8; j++) {
+			curve25519_contract(rb, in[j]);
+			reference_mul(want, ra, rb);
+			curve25519_mul(c, in[i], in[j]);
+			curve25519_contract(got, c);
+			if (memcmp(want, got, 32) != 0)
+				return -1;
+		}
+
+		/* square and square_times against repeated reference squaring */
+		memcpy(want, ra, 32);
+		reference_mul(want, want, want);
+		curve25519_square(a, in[i]);
+		curve25519_contract(got, a);
+		if (memcmp(want, got, 32) != 0)
+			return -1;
+		for (k = 1; k < 6; k++) {
+			curve25519_square_times(b, in[i], k);
+			curve25519_contract(got, b);
+			if (memcmp(want, got, 32) != 0)
+				return -1;
+			reference_mul(want, want, want);
+		}
+	}
+
+	return 0;
+}
 
 int
 main() {
@@ -169,6 +287,9 @@ main() {
 	single = test_subs();
 	if (single) printf("test_subs: FAILED\n");
 	ret |= single;
+	single = test_mul_reference();
+	if (single) printf("test_mul_reference: FAILED\n");
+	ret |= single;
 	if (!ret) printf("success\n");
 	return ret;
 }
@@ -11,6 +11,7 @@
 #include <stdio.h>
 
 #include "ristretto-donna.h"
+#include "ed25519.h"
 
 /// Random element a of GF(2^255-19), from Sage
 /// a = 10703145068883540813293858232352184442332212228051251926706380353716438957572
@@ -50,6 +51,114 @@ const unsigned char IDENTITY[32] = {0, 0, 0, 0, 0, 0, 0, 0,
                                     0, 0, 0, 0, 0, 0, 0, 0,
                                     0, 0, 0, 0, 0, 0, 0, 0};
 
+/// Encodings of [0]B, [1]B, ..., [15]B, where B is the Ristretto basepoint
+const unsigned char SMALL_MULTIPLES_OF_BASEPOINT[16][32] = {
+  // This is the identity
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+  // This is the basepoint
+  {0xe2, 0xf2, 0xae, 0x0a, 0x6a, 0xbc, 0x4e, 0x71, 0xa8, 0x84, 0xa9, 0x61, 0xc5, 0x00, 0x51, 0x5f,
+   0x58, 0xe3, 0x0b, 0x6a, 0xa5, 0x82, 0xdd, 0x8d, 0xb6, 0xa6, 0x59, 0x45, 0xe0, 0x8d, 0x2d, 0x76},
+  // These are small multiples of the basepoint
+  {0x6a, 0x49, 0x32, 0x10, 0xf7, 0x49, 0x9c, 0xd1, 0x7f, 0xec, 0xb5, 0x10, 0xae, 0x0c, 0xea, 0x23,
+   0xa1, 0x10, 0xe8, 0xd5, 0xb9, 0x01, 0xf8, 0xac, 0xad, 0xd3, 0x09, 0x5c, 0x73, 0xa3, 0xb9, 0x19},
+  {0x94, 0x74, 0x1f, 0x5d, 0x5d, 0x52, 0x75, 0x5e, 0xce, 0x4f, 0x23, 0xf0, 0x44, 0xee, 0x27, 0xd5,
+   0xd1, 0xea, 0x1e, 0x2b, 0xd1, 0x96, 0xb4, 0x62, 0x16, 0x6b, 0x16, 0x15, 0x2a, 0x9d, 0x02, 0x59},
+  {0xda, 0x80, 0x86, 0x27, 0x73, 0x35, 0x8b, 0x46, 0x6f, 0xfa, 0xdf, 0xe0, 0xb3, 0x29, 0x3a, 0xb3,
+   0xd9, 0xfd, 0x53, 0xc5, 0xea, 0x6c, 0x95, 0x53, 0x58, 0xf5, 0x68, 0x32, 0x2d, 0xaf, 0x6a, 0x57},
+  {0xe8, 0x82, 0xb1, 0x31, 0x01, 0x6b, 0x52, 0xc1, 0xd3, 0x33, 0x70, 0x80, 0x18, 0x7c, 0xf7, 0x68,
+   0x42, 0x3e, 0xfc, 0xcb, 0xb5, 0x17, 0xbb, 0x49, 0x5a, 0xb8, 0x12, 0xc4, 0x16, 0x0f, 0xf4, 0x4e},
+  {0xf6, 0x47, 0x46, 0xd3, 0xc9, 0x2b, 0x13, 0x05, 0x0e, 0xd8, 0xd8, 0x02, 0x36, 0xa7, 0xf0, 0x00,
+   0x7c, 0x3b, 0x3f, 0x96, 0x2f, 0x5b, 0xa7, 0x93, 0xd1, 0x9a, 0x60, 0x1e, 0xbb, 0x1d, 0xf4, 0x03},
+  {0x44, 0xf5, 0x35, 0x20, 0x92, 0x6e, 0xc8, 0x1f, 0xbd, 0x5a, 0x38, 0x78, 0x45, 0xbe, 0xb7, 0xdf,
+   0x85, 0xa9, 0x6a, 0x24, 0xec, 0xe1, 0x87, 0x38, 0xbd, 0xcf, 0xa6, 0xa7, 0x82, 0x2a, 0x17, 0x6d},
+  {0x90, 0x32, 0x93, 0xd8, 0xf2, 0x28, 0x7e, 0xbe, 0x10, 0xe2, 0x37, 0x4d, 0xc1, 0xa5, 0x3e, 0x0b,
+   0xc8, 0x87, 0xe5, 0x92, 0x69, 0x9f, 0x02, 0xd0, 0x77, 0xd5, 0x26, 0x3c, 0xdd, 0x55, 0x60, 0x1c},
+  {0x02, 0x62, 0x2a, 0xce, 0x8f, 0x73, 0x03, 0xa3, 0x1c, 0xaf, 0xc6, 0x3f, 0x8f, 0xc4, 0x8f, 0xdc,
+   0x16, 0xe1, 0xc8, 0xc8, 0xd2, 0x34, 0xb2, 0xf0, 0xd6, 0x68, 0x52, 0x82, 0xa9, 0x07, 0x60, 0x31},
+  {0x20, 0x70, 0x6f, 0xd7, 0x88, 0xb2, 0x72, 0x0a, 0x1e, 0xd2, 0xa5, 0xda, 0xd4, 0x95, 0x2b, 0x01,
+   0xf4, 0x13, 0xbc, 0xf0, 0xe7, 0x56, 0x4d, 0xe8, 0xcd, 0xc8, 0x16, 0x68, 0x9e, 0x2d, 0xb9, 0x5f},
+  {0xbc, 0xe8, 0x3f, 0x8b, 0xa5, 0xdd, 0x2f, 0xa5, 0x72, 0x86, 0x4c, 0x24, 0xba, 0x18, 0x10, 0xf9,
+   0x52, 0x2b, 0xc6, 0x00, 0x4a, 0xfe, 0x95, 0x87, 0x7a, 0xc7, 0x32, 0x41, 0xca, 0xfd, 0xab, 0x42},
+  {0xe4, 0x54, 0x9e, 0xe1, 0x6b, 0x9a, 0xa0, 0x30, 0x99, 0xca, 0x20, 0x8c, 0x67, 0xad, 0xaf, 0xca,
+   0xfa, 0x4c, 0x3f, 0x3e, 0x4e, 0x53, 0x03, 0xde, 0x60, 0x26, 0xe3, 0xca, 0x8f, 0xf8, 0x44, 0x60},
+  {0xaa, 0x52, 0xe0, 0x00, 0xdf, 0x2e, 0x16, 0xf5, 0x5f, 0xb1, 0x03, 0x2f, 0xc3, 0x3b, 0xc4, 0x27,
+   0x42, 0xda, 0xd6, 0xbd, 0x5a, 0x8f, 0xc0, 0xbe, 0x01, 0x67, 0x43, 0x6c, 0x59, 0x48, 0x50, 0x1f},
+  {0x46, 0x37, 0x6b, 0x80, 0xf4, 0x09, 0xb2, 0x9d, 0xc2, 0xb5, 0xf6, 0xf0, 0xc5, 0x25, 0x91, 0x99,
+   0x08, 0x96, 0xe5, 0x71, 0x6f, 0x41, 0x47, 0x7c, 0xd3, 0x00, 0x85, 0xab, 0x7f, 0x10, 0x30, 0x1e},
+  {0xe0, 0xc4, 0x18, 0xf7, 0xc8, 0xd9, 0xc4, 0xcd, 0xd7, 0x39, 0x5b, 0x93, 0xea, 0x12, 0x4f, 0x3a,
+   0xd9, 0x90, 0x21, 0xbb, 0x68, 0x1d, 0xfc, 0x33, 0x02, 0xa9, 0xd9, 0x9a, 0x2e, 0x53, 0xe6, 0x4e},
+};
+
+/// RFC 9496 one-way map test vector, the SHA-512 digest of
+/// "Ristretto is traditionally a short shot of espresso coffee"
+const unsigned char UNIFORM_BYTES_VECTOR[64] = {
+  0x5d, 0x1b, 0xe0, 0x9e, 0x3d, 0x0c, 0x82, 0xfc,
+  0x53, 0x81, 0x12, 0x49, 0x0e, 0x35, 0x70, 0x19,
+  0x79, 0xd9, 0x9e, 0x06, 0xca, 0x3e, 0x2b, 0x5b,
+  0x54, 0xbf, 0xfe, 0x8b, 0x4d, 0xc7, 0x72, 0xc1,
+  0x4d, 0x98, 0xb6, 0x96, 0xa1, 0xbb, 0xfb, 0x5c,
+  0xa3, 0x2c, 0x43, 0x6c, 0xc6, 0x1c, 0x16, 0x56,
+  0x37, 0x90, 0x30, 0x6c, 0x79, 0xea, 0xca, 0x77,
+  0x05, 0x66, 0x8b, 0x47, 0xdf, 0xfe, 0x5b, 0xb6
+};
+
+/// Encoding of the point UNIFORM_BYTES_VECTOR maps to
+const unsigned char UNIFORM_BYTES_VECTOR_ENCODED[32] = {
+  0x30, 0x66, 0xf8, 0x2a, 0x1a, 0x74, 0x7d, 0x45,
+  0x12, 0x0d, 0x17, 0x40, 0xf1, 0x43, 0x58, 0x53,
+  0x1a, 0x8f, 0x04, 0xbb, 0xff, 0xe6, 0xa8, 0x19,
+  0xf8, 0x6d, 0xfe, 0x50, 0xf4, 0x4a, 0x0a, 0x46
+};
+
+/// Encoding of the point 64 bytes of 0xff map to
+const unsigned char UNIFORM_BYTES_ALL_ONES_ENCODED[32] = {
+  0xa6, 0x4d, 0x86, 0x82, 0x0a, 0xbd, 0x39, 0x3c,
+  0x6a, 0x5f, 0xee, 0xf9, 0x5b, 0x64, 0x94, 0x5b,
+  0xc0, 0xc5, 0x70, 0xad, 0xeb, 0xae, 0x17, 0xa9,
+  0x98, 0x82, 0x21, 0x69, 0x45, 0xfb, 0xd3, 0x7a
+};
+
+/// Encoding of the empty message hashed to the group
+const unsigned char HASH_TO_GROUP_EMPTY_ENCODED[32] = {
+  0x84, 0x72, 0x86, 0x5e, 0xba, 0x3c, 0x2c, 0x54,
+  0xe5, 0x5e, 0x71, 0xe4, 0xae, 0x6b, 0x1f, 0x88,
+  0xc6, 0xe8, 0xa8, 0xe4, 0x4c, 0x49, 0x3b, 0x59,
+  0xbc, 0x46, 0xb8, 0x35, 0xe1, 0x68, 0x68, 0x1d
+};
+
+/// 1/a (mod l), where a is A_BYTES read as a scalar
+const uint8_t A_BYTES_SCALAR_INVERSE[32] = {
+  0x61, 0x26, 0x5a, 0x50, 0xd5, 0x16, 0x6f, 0x8f,
+  0x11, 0x6e, 0xc9, 0x78, 0x92, 0xe3, 0xc1, 0x9e,
+  0x2e, 0x8c, 0x21, 0x4b, 0x97, 0xa7, 0x2d, 0xb8,
+  0xe6, 0x1d, 0x34, 0x08, 0x6a, 0x80, 0x51, 0x01
+};
+
+/// -a (mod l), where a is A_BYTES read as a scalar
+const uint8_t A_BYTES_SCALAR_NEGATED[32] = {
+  0xd6, 0xa9, 0x0b, 0x21, 0x8d, 0xcb, 0x19, 0x48,
+  0x28, 0xa7, 0x31, 0xec, 0xb4, 0xec, 0x16, 0x26,
+  0x62, 0x2e, 0x09, 0x0d, 0x1e, 0x26, 0x1d, 0x5b,
+  0x5b, 0xae, 0xb8, 0xc9, 0x0c, 0x3c, 0x56, 0x08
+};
+
+/// a^2 (mod l), where a is A_BYTES read as a scalar
+const uint8_t A_BYTES_SCALAR_SQUARED[32] = {
+  0x7e, 0xd5, 0xb4, 0x99, 0xad, 0xd9, 0xee, 0x77,
+  0xe6, 0xf7, 0x01, 0xce, 0xad, 0xd4, 0xb2, 0xf5,
+  0xe3, 0xb8, 0x16, 0x67, 0x3c, 0x93, 0x81, 0xc7,
+  0x03, 0x4f, 0x1e, 0x44, 0x4d, 0xbc, 0xf2, 0x0d
+};
+
+/// (2^512 - 1) (mod l)
+const uint8_t ALL_ONES_WIDE_SCALAR_REDUCED[32] = {
+  0x00, 0x0f, 0x9c, 0x44, 0xe3, 0x11, 0x06, 0xa4,
+  0x47, 0x93, 0x85, 0x68, 0xa7, 0x1b, 0x0e, 0xd0,
+  0x65, 0xbe, 0xf5, 0x17, 0xd2, 0x73, 0xec, 0xce,
+  0x3d, 0x9a, 0x30, 0x7c, 0x1b, 0x41, 0x99, 0x03
+};
+
 void print_uchar32(unsigned char uchar[32])
 {
   unsigned char i;
@@ -66,7 +175,7 @@ void print_uchar32(unsigned char uchar[32])
 
 int test_curve25519_expand_random_field_element()
 {
-  bignum25519 a;
+  bignum25519 ALIGN(16) a;
   unsigned char a_bytes[32]; // discard the const qualifier
   unsigned char b[32];
 
@@ -90,7 +199,7 @@ int test_curve25519_expand_random_field_element()
 
 int test_curve25519_expand_basepoint()
 {
-  bignum25519 a;
+  bignum25519 ALIGN(16) a;
   unsigned char b[32];
 
   printf("expanding and contracting basepoint: ");
@@ -111,7 +220,7 @@ int test_curve25519_expand_basepoint()
 
 int test_curve25519_expand_identity()
 {
-  bignum25519 a;
+  bignum25519 ALIGN(16) a;
   unsigned char b[32];
 
   printf("test expanding and contracting additive identity: ");
@@ -132,7 +241,7 @@ int test_curve25519_expand_identity()
 
 int test_ge25519_unpack_pack()
 {
-  ge25519 a;
+  ge25519 ALIGN(16) a;
   unsigned char b[32];
   int result;
 
@@ -158,7 +267,7 @@ int test_ge25519_unpack_pack()
 
 int test_invsqrt_random_field_element()
 {
-  bignum25519 check, v, v_invsqrt;
+  bignum25519 ALIGN(16) check, v, v_invsqrt;
   uint8_t result;
 
   // Use v = decode(ASQ_BYTES) so it's guaranteed to be square
@@ -204,6 +313,45 @@ int test_invsqrt_random_field_element()
 
 }
 
+int test_field_constants()
+{
+  bignum25519 ALIGN(16) check, minus_one_minus_d;
+  unsigned char bytes[32];
+  uint8_t result = 1;
+
+  printf("test field constants: ");
+
+  curve25519_add_reduce(check, negative_one, one);
+  curve25519_contract(bytes, check);
+  if (!uint8_32_ct_eq(bytes, IDENTITY)) {
+    printf("  - FAIL negative_one + one was not zero\n");
+    result &= 0;
+  }
+
+  curve25519_square(check, SQRT_M1);
+  if (bignum25519_ct_eq(check, negative_one) != 1) {
+    printf("  - FAIL SQRT_M1 squared was not -1\n");
+    result &= 0;
+  }
+
+  // INVSQRT_A_MINUS_D² (a - d) = 1, where a = -1
+  curve25519_sub_reduce(minus_one_minus_d, negative_one, EDWARDS_D);
+  curve25519_square(check, INVSQRT_A_MINUS_D);
+  curve25519_mul(check, check, minus_one_minus_d);
+  if (bignum25519_ct_eq(check, one) != 1) {
+    printf("  - FAIL INVSQRT_A_MINUS_D was not 1/sqrt(a-d)\n");
+    result &= 0;
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
 int test_ristretto_decode_random_invalid_point()
 {
   ristretto_point_t point;
@@ -245,43 +393,6 @@ int test_ristretto_encode_small_multiples_of_basepoint()
   ristretto_point_t P, B;
   unsigned char i;
   unsigned char encoded[32];
-  unsigned char encodings_of_small_multiples[16][32] = {
-    // This is the identity
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    // This is the basepoint
-    {0xe2, 0xf2, 0xae, 0x0a, 0x6a, 0xbc, 0x4e, 0x71, 0xa8, 0x84, 0xa9, 0x61, 0xc5, 0x00, 0x51, 0x5f,
-     0x58, 0xe3, 0x0b, 0x6a, 0xa5, 0x82, 0xdd, 0x8d, 0xb6, 0xa6, 0x59, 0x45, 0xe0, 0x8d, 0x2d, 0x76},
-    // These are small multiples of the basepoint
-    {0x6a, 0x49, 0x32, 0x10, 0xf7, 0x49, 0x9c, 0xd1, 0x7f, 0xec, 0xb5, 0x10, 0xae, 0x0c, 0xea, 0x23,
-     0xa1, 0x10, 0xe8, 0xd5, 0xb9, 0x01, 0xf8, 0xac, 0xad, 0xd3, 0x09, 0x5c, 0x73, 0xa3, 0xb9, 0x19},
-    {0x94, 0x74, 0x1f, 0x5d, 0x5d, 0x52, 0x75, 0x5e, 0xce, 0x4f, 0x23, 0xf0, 0x44, 0xee, 0x27, 0xd5,
-     0xd1, 0xea, 0x1e, 0x2b, 0xd1, 0x96, 0xb4, 0x62, 0x16, 0x6b, 0x16, 0x15, 0x2a, 0x9d, 0x02, 0x59},
-    {0xda, 0x80, 0x86, 0x27, 0x73, 0x35, 0x8b, 0x46, 0x6f, 0xfa, 0xdf, 0xe0, 0xb3, 0x29, 0x3a, 0xb3,
-     0xd9, 0xfd, 0x53, 0xc5, 0xea, 0x6c, 0x95, 0x53, 0x58, 0xf5, 0x68, 0x32, 0x2d, 0xaf, 0x6a, 0x57},
-    {0xe8, 0x82, 0xb1, 0x31, 0x01, 0x6b, 0x52, 0xc1, 0xd3, 0x33, 0x70, 0x80, 0x18, 0x7c, 0xf7, 0x68,
-     0x42, 0x3e, 0xfc, 0xcb, 0xb5, 0x17, 0xbb, 0x49, 0x5a, 0xb8, 0x12, 0xc4, 0x16, 0x0f, 0xf4, 0x4e},
-    {0xf6, 0x47, 0x46, 0xd3, 0xc9, 0x2b, 0x13, 0x05, 0x0e, 0xd8, 0xd8, 0x02, 0x36, 0xa7, 0xf0, 0x00,
-     0x7c, 0x3b, 0x3f, 0x96, 0x2f, 0x5b, 0xa7, 0x93, 0xd1, 0x9a, 0x60, 0x1e, 0xbb, 0x1d, 0xf4, 0x03},
-    {0x44, 0xf5, 0x35, 0x20, 0x92, 0x6e, 0xc8, 0x1f, 0xbd, 0x5a, 0x38, 0x78, 0x45, 0xbe, 0xb7, 0xdf,
-     0x85, 0xa9, 0x6a, 0x24, 0xec, 0xe1, 0x87, 0x38, 0xbd, 0xcf, 0xa6, 0xa7, 0x82, 0x2a, 0x17, 0x6d},
-    {0x90, 0x32, 0x93, 0xd8, 0xf2, 0x28, 0x7e, 0xbe, 0x10, 0xe2, 0x37, 0x4d, 0xc1, 0xa5, 0x3e, 0x0b,
-     0xc8, 0x87, 0xe5, 0x92, 0x69, 0x9f, 0x02, 0xd0, 0x77, 0xd5, 0x26, 0x3c, 0xdd, 0x55, 0x60, 0x1c},
-    {0x02, 0x62, 0x2a, 0xce, 0x8f, 0x73, 0x03, 0xa3, 0x1c, 0xaf, 0xc6, 0x3f, 0x8f, 0xc4, 0x8f, 0xdc,
-     0x16, 0xe1, 0xc8, 0xc8, 0xd2, 0x34, 0xb2, 0xf0, 0xd6, 0x68, 0x52, 0x82, 0xa9, 0x07, 0x60, 0x31},
-    {0x20, 0x70, 0x6f, 0xd7, 0x88, 0xb2, 0x72, 0x0a, 0x1e, 0xd2, 0xa5, 0xda, 0xd4, 0x95, 0x2b, 0x01,
-     0xf4, 0x13, 0xbc, 0xf0, 0xe7, 0x56, 0x4d, 0xe8, 0xcd, 0xc8, 0x16, 0x68, 0x9e, 0x2d, 0xb9, 0x5f},
-    {0xbc, 0xe8, 0x3f, 0x8b, 0xa5, 0xdd, 0x2f, 0xa5, 0x72, 0x86, 0x4c, 0x24, 0xba, 0x18, 0x10, 0xf9,
-     0x52, 0x2b, 0xc6, 0x00, 0x4a, 0xfe, 0x95, 0x87, 0x7a, 0xc7, 0x32, 0x41, 0xca, 0xfd, 0xab, 0x42},
-    {0xe4, 0x54, 0x9e, 0xe1, 0x6b, 0x9a, 0xa0, 0x30, 0x99, 0xca, 0x20, 0x8c, 0x67, 0xad, 0xaf, 0xca,
-     0xfa, 0x4c, 0x3f, 0x3e, 0x4e, 0x53, 0x03, 0xde, 0x60, 0x26, 0xe3, 0xca, 0x8f, 0xf8, 0x44, 0x60},
-    {0xaa, 0x52, 0xe0, 0x00, 0xdf, 0x2e, 0x16, 0xf5, 0x5f, 0xb1, 0x03, 0x2f, 0xc3, 0x3b, 0xc4, 0x27,
-     0x42, 0xda, 0xd6, 0xbd, 0x5a, 0x8f, 0xc0, 0xbe, 0x01, 0x67, 0x43, 0x6c, 0x59, 0x48, 0x50, 0x1f},
-    {0x46, 0x37, 0x6b, 0x80, 0xf4, 0x09, 0xb2, 0x9d, 0xc2, 0xb5, 0xf6, 0xf0, 0xc5, 0x25, 0x91, 0x99,
-     0x08, 0x96, 0xe5, 0x71, 0x6f, 0x41, 0x47, 0x7c, 0xd3, 0x00, 0x85, 0xab, 0x7f, 0x10, 0x30, 0x1e},
-    {0xe0, 0xc4, 0x18, 0xf7, 0xc8, 0xd9, 0xc4, 0xcd, 0xd7, 0x39, 0x5b, 0x93, 0xea, 0x12, 0x4f, 0x3a,
-     0xd9, 0x90, 0x21, 0xbb, 0x68, 0x1d, 0xfc, 0x33, 0x02, 0xa9, 0xd9, 0x9a, 0x2e, 0x53, 0xe6, 0x4e},
-  };
 
   printf("encoding small multiples of basepoint: ");
 
@@ -291,10 +402,10 @@ int test_ristretto_encode_small_multiples_of_basepoint()
   for (i=0; i<16; i++) {
     ristretto_encode(encoded, (const ristretto_point_t*)&P);
 
-    if (!uint8_32_ct_eq(encoded, encodings_of_small_multiples[i])) {
+    if (!uint8_32_ct_eq(encoded, SMALL_MULTIPLES_OF_BASEPOINT[i])) {
       printf("  - FAIL small multiple #%d failed to encode correctly\n", i);
       PRINT("    original = ");
-      print_uchar32(encodings_of_small_multiples[i]);
+      print_uchar32((unsigned char*)SMALL_MULTIPLES_OF_BASEPOINT[i]);
       PRINT("    encoded = ");
       print_uchar32(encoded);
       result &= 0;
@@ -422,12 +533,864 @@ int test_ristretto_ct_eq()
   return result;
 }
 
+int test_ristretto_scalarmult_small_multiples_of_basepoint()
+{
+  uint8_t result = 1;
+  ristretto_point_t P;
+  unsigned char scalar[32] = {0};
+  unsigned char encoded[32];
+  unsigned char i;
+
+  printf("test scalar multiplication by small scalars: ");
+
+  for (i=0; i<16; i++) {
+    scalar[0] = i;
+    ristretto_scalarmult(&P, &RISTRETTO_BASEPOINT_POINT, scalar);
+    ristretto_encode(encoded, &P);
+
+    if (!uint8_32_ct_eq(encoded, SMALL_MULTIPLES_OF_BASEPOINT[i])) {
+      printf("  - FAIL [%d]B was computed incorrectly\n", i);
+      PRINT("    expected = ");
+      print_uchar32((unsigned char*)SMALL_MULTIPLES_OF_BASEPOINT[i]);
+      PRINT("    computed = ");
+      print_uchar32(encoded);
+      result &= 0;
+    }
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_scalarmult_base_small_multiples()
+{
+  uint8_t result = 1;
+  ristretto_point_t P, Q;
+  unsigned char scalar[32] = {0};
+  unsigned char encoded[32];
+  unsigned char i;
+
+  printf("test basepoint scalar multiplication by small scalars: ");
+
+  for (i=0; i<16; i++) {
+    scalar[0] = i;
+    ristretto_scalarmult_base(&P, scalar);
+    ristretto_encode(encoded, &P);
+
+    if (!uint8_32_ct_eq(encoded, SMALL_MULTIPLES_OF_BASEPOINT[i])) {
+      printf("  - FAIL [%d]B was computed incorrectly\n", i);
+      result &= 0;
+    }
+  }
+
+  // A full-size scalar should agree with the variable-base path
+  ristretto_scalarmult_base(&P, A_BYTES);
+  ristretto_scalarmult(&Q, &RISTRETTO_BASEPOINT_POINT, A_BYTES);
+
+  if (ristretto_ct_eq(&P, &Q) != 1) {
+    printf("  - FAIL [a]B did not match the variable-base result\n");
+    result &= 0;
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_scalarmult_matches_basepoint_table()
+{
+  uint8_t result = 1;
+  ristretto_point_t P;
+  ge25519 Q;
+  bignum256modm s;
+  unsigned char scalars[2][32];
+  unsigned char computed[32];
+  unsigned char expected[32];
+  unsigned char i;
+
+  printf("test scalar multiplication against basepoint table: ");
+
+  // One ordinary scalar and one which needs reducing modulo the group order
+  memcpy(scalars[0], A_BYTES, 32);
+  memset(scalars[1], 0xff, 32);
+
+  for (i=0; i<2; i++) {
+    ristretto_scalarmult(&P, &RISTRETTO_BASEPOINT_POINT, scalars[i]);
+    ristretto_encode(computed, &P);
+
+    expand256_modm(s, scalars[i], 32);
+    ge25519_scalarmult_base_niels(&Q, ge25519_niels_base_multiples, s);
+    memcpy(&P.point, &Q, sizeof(ge25519));
+    ristretto_encode(expected, &P);
+
+    if (!uint8_32_ct_eq(computed, expected)) {
+      printf("  - FAIL scalar #%d did not match the basepoint table\n", i);
+      result &= 0;
+    }
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_double_scalarmult_vartime()
+{
+  uint8_t result = 1;
+  ristretto_point_t P, aP, bB, R;
+  bignum256modm a, b;
+  unsigned char computed[32];
+  unsigned char expected[32];
+
+  printf("test variable-time double scalar multiplication: ");
+
+  ristretto_decode(&P, SMALL_MULTIPLES_OF_BASEPOINT[5]);
+  expand256_modm(a, A_BYTES, 32);
+  expand256_modm(b, AP58_BYTES, 32);
+
+  ristretto_double_scalarmult_vartime(&R, &P, a, b);
+  ristretto_encode(computed, &R);
+
+  ristretto_scalarmult(&aP, &P, A_BYTES);
+  ristretto_scalarmult_base(&bB, AP58_BYTES);
+  ge25519_add(&R.point, &aP.point, &bB.point);
+  ristretto_encode(expected, &R);
+
+  if (!uint8_32_ct_eq(computed, expected)) {
+    result &= 0;
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+/// Fill `bytes` with deterministic pseudorandom junk derived from `seed`
+void fill_pseudorandom_bytes(unsigned char *bytes, size_t len, uint32_t seed)
+{
+  size_t i;
+
+  for (i=0; i<len; i++) {
+    seed = seed * 1103515245 + 12345;
+    bytes[i] = (unsigned char)(seed >> 16);
+  }
+}
+
+int test_ristretto_multiscalar_mul_vartime()
+{
+  const size_t sizes[3] = {1, 7, 200};
+  ristretto_point_t *points;
+  bignum256modm *scalars;
+  ristretto_point_t expected, computed, term;
+  unsigned char bytes[32];
+  unsigned char expected_bytes[32];
+  unsigned char computed_bytes[32];
+  uint8_t result = 1;
+  size_t i, j, n;
+
+  printf("test multiscalar multiplication: ");
+
+  points = (ristretto_point_t*)malloc(200 * sizeof(ristretto_point_t));
+  scalars = (bignum256modm*)malloc(200 * sizeof(bignum256modm));
+
+  for (j=0; j<3; j++) {
+    n = sizes[j];
+
+    ristretto_decode(&expected, IDENTITY);
+
+    for (i=0; i<n; i++) {
+      fill_pseudorandom_bytes(bytes, 32, (uint32_t)(i + 1));
+      ristretto_scalarmult_base(&points[i], bytes);
+
+      // Exercise a zero scalar and one which needs reducing
+      if (i == 1) {
+        memset(bytes, 0, 32);
+      } else if (i == 2) {
+        memset(bytes, 0xff, 32);
+      } else {
+        fill_pseudorandom_bytes(bytes, 32, (uint32_t)(i + 1000));
+      }
+      expand256_modm(scalars[i], bytes, 32);
+
+      ristretto_scalarmult(&term, &points[i], bytes);
+      ge25519_add(&expected.point, &expected.point, &term.point);
+    }
+    ristretto_encode(expected_bytes, &expected);
+
+    ristretto_multiscalar_mul_straus_vartime(&computed, points, scalars, n);
+    ristretto_encode(computed_bytes, &computed);
+    if (!uint8_32_ct_eq(expected_bytes, computed_bytes)) {
+      printf("  - FAIL Straus with n=%zu\n", n);
+      result &= 0;
+    }
+
+    ristretto_multiscalar_mul_pippenger_vartime(&computed, points, scalars, n);
+    ristretto_encode(computed_bytes, &computed);
+    if (!uint8_32_ct_eq(expected_bytes, computed_bytes)) {
+      printf("  - FAIL Pippenger with n=%zu\n", n);
+      result &= 0;
+    }
+
+    ristretto_multiscalar_mul_vartime(&computed, points, scalars, n);
+    ristretto_encode(computed_bytes, &computed);
+    if (!uint8_32_ct_eq(expected_bytes, computed_bytes)) {
+      printf("  - FAIL multiscalar with n=%zu\n", n);
+      result &= 0;
+    }
+  }
+
+  free(points);
+  free(scalars);
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_double_and_encode_batch()
+{
+  ristretto_point_t points[8];
+  unsigned char encoded[8][32];
+  uint8_t result = 1;
+  unsigned char i;
+
+  printf("test batch doubling and encoding: ");
+
+  // Decode [0]B, [1]B, ..., [7]B, so that doubling yields [0]B, [2]B, ..., [14]B
+  for (i=0; i<8; i++) {
+    ristretto_decode(&points[i], SMALL_MULTIPLES_OF_BASEPOINT[i]);
+  }
+
+  // Make sure points with Z != 1 are handled too
+  ge25519_add(&points[3].point, &points[1].point, &points[2].point);
+
+  if (ristretto_double_and_encode_batch(encoded, points, 8) != 1) {
+    result &= 0;
+  }
+
+  for (i=0; i<8; i++) {
+    if (!uint8_32_ct_eq(encoded[i], SMALL_MULTIPLES_OF_BASEPOINT[2*i])) {
+      printf("  - FAIL [2*%d]B was encoded incorrectly\n", i);
+      result &= 0;
+    }
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_decode_batch()
+{
+  unsigned char encodings[19][32];
+  ristretto_point_t batch[19];
+  ristretto_point_t single;
+  unsigned char encoded[32];
+  int valid[19];
+  int all_valid;
+  uint8_t result = 1;
+  size_t i;
+
+  printf("test batch decoding: ");
+
+  // Three groups, the last one partially filled, with invalid encodings
+  // mixed in among the valid ones
+  for (i=0; i<16; i++) {
+    memcpy(encodings[i], SMALL_MULTIPLES_OF_BASEPOINT[i], 32);
+  }
+  memcpy(encodings[16], A_BYTES, 32);                     // not a point
+  memcpy(encodings[17], SMALL_MULTIPLES_OF_BASEPOINT[2], 32);
+  encodings[17][0] ^= 1;                                  // negative s
+  memset(encodings[18], 0xff, 32);
+  encodings[18][0] = 0xed;
+  encodings[18][31] = 0x7f;                               // s = p, non-canonical
+  memcpy(encoded, encodings[3], 32);
+  memcpy(encodings[3], encodings[17], 32);
+  memcpy(encodings[17], encoded, 32);                     // an invalid one in the first group
+
+  for (i=0; i<19; i++) {
+    batch[i] = RISTRETTO_BASEPOINT_POINT;
+  }
+
+  all_valid = ristretto_decode_batch(batch, (const unsigned char (*)[32])encodings, 19, valid);
+
+  if (all_valid != 0) {
+    printf("  - FAIL invalid encodings were not reported\n");
+    result &= 0;
+  }
+
+  for (i=0; i<19; i++) {
+    single = RISTRETTO_BASEPOINT_POINT;
+    if (valid[i] != ristretto_decode(&single, encodings[i])) {
+      printf("  - FAIL encoding #%zu was not flagged like ristretto_decode()\n", i);
+      result &= 0;
+    }
+    if (ristretto_ct_eq(&single, &batch[i]) != 1) {
+      printf("  - FAIL encoding #%zu did not decode like ristretto_decode()\n", i);
+      result &= 0;
+    }
+    if (valid[i] != ((i < 16 && i != 3) || i == 17)) {
+      printf("  - FAIL encoding #%zu had the wrong validity\n", i);
+      result &= 0;
+    }
+  }
+
+  if (ristretto_decode_batch(batch, (const unsigned char (*)[32])encodings, 3, valid) != 1) {
+    printf("  - FAIL a batch of valid encodings was not reported valid\n");
+    result &= 0;
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_encode_batch()
+{
+  ristretto_point_t points[13];
+  unsigned char batch[13][32];
+  unsigned char single[32];
+  unsigned char bytes[32];
+  uint8_t result = 1;
+  size_t i;
+
+  printf("test batch encoding: ");
+
+  // Results of scalar multiplication have arbitrary Z; include the identity
+  for (i=0; i<13; i++) {
+    fill_pseudorandom_bytes(bytes, 32, (uint32_t)(i + 1));
+    if (i == 5) {
+      memset(bytes, 0, 32);
+    }
+    ristretto_scalarmult_base(&points[i], bytes);
+  }
+
+  ristretto_encode_batch(batch, points, 13);
+
+  for (i=0; i<13; i++) {
+    ristretto_encode(single, &points[i]);
+
+    if (!uint8_32_ct_eq(single, batch[i])) {
+      printf("  - FAIL point #%zu did not match ristretto_encode()\n", i);
+      result &= 0;
+    }
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_from_uniform_bytes()
+{
+  ristretto_point_t P;
+  unsigned char all_ones[64];
+  unsigned char encoded[32];
+  const char *message = "Ristretto is traditionally a short shot of espresso coffee";
+  uint8_t result = 1;
+
+  printf("test mapping uniform bytes to the group: ");
+
+  ristretto_from_uniform_bytes(&P, UNIFORM_BYTES_VECTOR);
+  ristretto_encode(encoded, &P);
+  if (!uint8_32_ct_eq(encoded, UNIFORM_BYTES_VECTOR_ENCODED)) {
+    printf("  - FAIL RFC 9496 test vector\n");
+    result &= 0;
+  }
+
+  // Non-canonical field elements, with the high bit set
+  memset(all_ones, 0xff, 64);
+  ristretto_from_uniform_bytes(&P, all_ones);
+  ristretto_encode(encoded, &P);
+  if (!uint8_32_ct_eq(encoded, UNIFORM_BYTES_ALL_ONES_ENCODED)) {
+    printf("  - FAIL all-ones input\n");
+    result &= 0;
+  }
+
+  ristretto_hash_to_group(&P, (const unsigned char*)message, strlen(message));
+  ristretto_encode(encoded, &P);
+  if (!uint8_32_ct_eq(encoded, UNIFORM_BYTES_VECTOR_ENCODED)) {
+    printf("  - FAIL hash to group\n");
+    result &= 0;
+  }
+
+  ristretto_hash_to_group(&P, NULL, 0);
+  ristretto_encode(encoded, &P);
+  if (!uint8_32_ct_eq(encoded, HASH_TO_GROUP_EMPTY_ENCODED)) {
+    printf("  - FAIL hash to group of the empty message\n");
+    result &= 0;
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_from_uniform_bytes_batch()
+{
+  unsigned char inputs[11][64];
+  ristretto_point_t batch[11];
+  ristretto_point_t single;
+  unsigned char batch_encoded[32];
+  unsigned char single_encoded[32];
+  uint8_t result = 1;
+  size_t i;
+
+  printf("test batch mapping uniform bytes to the group: ");
+
+  // An odd size, so that the last group is only partially filled
+  memcpy(inputs[0], UNIFORM_BYTES_VECTOR, 64);
+  memset(inputs[1], 0xff, 64);
+  for (i=2; i<11; i++) {
+    fill_pseudorandom_bytes(inputs[i], 64, (uint32_t)i);
+  }
+
+  ristretto_from_uniform_bytes_batch(batch, (const unsigned char (*)[64])inputs, 11);
+
+  for (i=0; i<11; i++) {
+    ristretto_from_uniform_bytes(&single, inputs[i]);
+    ristretto_encode(single_encoded, &single);
+    ristretto_encode(batch_encoded, &batch[i]);
+
+    if (!uint8_32_ct_eq(single_encoded, batch_encoded)) {
+      printf("  - FAIL input #%zu did not match the unbatched map\n", i);
+      result &= 0;
+    }
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_basepoint_table()
+{
+  ristretto_basepoint_table_t *table;
+  ristretto_point_t H, P, Q;
+  unsigned char scalar[32] = {0};
+  uint8_t result = 1;
+  unsigned char i;
+
+  printf("test precomputed tables for arbitrary points: ");
+
+  table = (ristretto_basepoint_table_t*)malloc(sizeof(ristretto_basepoint_table_t));
+
+  // A table built from the basepoint should be identical to the static one
+  ristretto_basepoint_table_create(table, &RISTRETTO_BASEPOINT_POINT);
+
+  if (memcmp(table->table, ge25519_niels_base_multiples, sizeof(table->table)) != 0) {
+    printf("  - FAIL table for B did not match ge25519_niels_base_multiples\n");
+    result &= 0;
+  }
+
+  // A table for some other generator should agree with the variable-base path
+  ristretto_from_uniform_bytes(&H, UNIFORM_BYTES_VECTOR);
+  ristretto_basepoint_table_create(table, &H);
+
+  for (i=0; i<16; i++) {
+    scalar[0] = i;
+    ristretto_basepoint_table_mul(&P, table, scalar);
+    ristretto_scalarmult(&Q, &H, scalar);
+
+    if (ristretto_ct_eq(&P, &Q) != 1) {
+      printf("  - FAIL [%d]H was computed incorrectly\n", i);
+      result &= 0;
+    }
+  }
+
+  ristretto_basepoint_table_mul(&P, table, A_BYTES);
+  ristretto_scalarmult(&Q, &H, A_BYTES);
+
+  if (ristretto_ct_eq(&P, &Q) != 1) {
+    printf("  - FAIL [a]H did not match the variable-base result\n");
+    result &= 0;
+  }
+
+  free(table);
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_basepoint_table_serialization()
+{
+  ristretto_basepoint_table_t *table;
+  const ristretto_basepoint_table_t *view;
+  ristretto_point_t H, P, Q;
+  unsigned char *buffer;
+  uint8_t result = 1;
+
+  printf("test serializing precomputed tables: ");
+
+  table = (ristretto_basepoint_table_t*)malloc(sizeof(ristretto_basepoint_table_t));
+  // Spare room to shift the serialized table off its alignment
+  buffer = (unsigned char*)malloc(RISTRETTO_TABLE_SERIALIZED_SIZE + 16);
+
+  ristretto_from_uniform_bytes(&H, UNIFORM_BYTES_VECTOR);
+  ristretto_basepoint_table_create(table, &H);
+
+  if (!ristretto_basepoint_table_store(buffer, RISTRETTO_TABLE_SERIALIZED_SIZE, table)) {
+    printf("  - FAIL could not store the table\n");
+    result &= 0;
+  }
+
+  // The loaded table should be a view into the buffer, not a copy
+  if (!ristretto_basepoint_table_load(&view, buffer, RISTRETTO_TABLE_SERIALIZED_SIZE) ||
+      (const unsigned char*)view != buffer + RISTRETTO_TABLE_HEADER_SIZE) {
+    printf("  - FAIL could not load the stored table\n");
+    result &= 0;
+  } else {
+    ristretto_basepoint_table_mul(&P, view, A_BYTES);
+    ristretto_scalarmult(&Q, &H, A_BYTES);
+
+    if (ristretto_ct_eq(&P, &Q) != 1) {
+      printf("  - FAIL [a]H from the loaded table was incorrect\n");
+      result &= 0;
+    }
+  }
+
+  if (ristretto_basepoint_table_load(&view, buffer, RISTRETTO_TABLE_SERIALIZED_SIZE - 1)) {
+    printf("  - FAIL loaded a truncated table\n");
+    result &= 0;
+  }
+
+  memmove(buffer + 1, buffer, RISTRETTO_TABLE_SERIALIZED_SIZE);
+  if (ristretto_basepoint_table_load(&view, buffer + 1, RISTRETTO_TABLE_SERIALIZED_SIZE)) {
+    printf("  - FAIL loaded a misaligned table\n");
+    result &= 0;
+  }
+  memmove(buffer, buffer + 1, RISTRETTO_TABLE_SERIALIZED_SIZE);
+
+  buffer[RISTRETTO_TABLE_HEADER_SIZE + 1000] ^= 1;
+  if (ristretto_basepoint_table_load(&view, buffer, RISTRETTO_TABLE_SERIALIZED_SIZE)) {
+    printf("  - FAIL loaded a table with a bad checksum\n");
+    result &= 0;
+  }
+  buffer[RISTRETTO_TABLE_HEADER_SIZE + 1000] ^= 1;
+
+  buffer[8] = RISTRETTO_TABLE_VERSION + 1;
+  if (ristretto_basepoint_table_load(&view, buffer, RISTRETTO_TABLE_SERIALIZED_SIZE)) {
+    printf("  - FAIL loaded a table with an unknown version\n");
+    result &= 0;
+  }
+
+  free(table);
+  free(buffer);
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_scalar_arithmetic()
+{
+  ristretto_scalar_t a, b, c, zero;
+  unsigned char bytes[64];
+  unsigned char zero_bytes[32] = {0};
+  unsigned char one_bytes[32] = {1};
+  uint8_t result = 1;
+
+  printf("test scalar arithmetic: ");
+
+  ristretto_scalar_from_bytes_mod_order(&a, A_BYTES);
+  ristretto_scalar_from_bytes_mod_order(&zero, zero_bytes);
+
+  ristretto_scalar_mul(&b, &a, &a);
+  ristretto_scalar_to_bytes(bytes, &b);
+  if (!uint8_32_ct_eq(bytes, A_BYTES_SCALAR_SQUARED)) {
+    printf("  - FAIL a*a was computed incorrectly\n");
+    result &= 0;
+  }
+
+  ristretto_scalar_neg(&b, &a);
+  ristretto_scalar_to_bytes(bytes, &b);
+  if (!uint8_32_ct_eq(bytes, A_BYTES_SCALAR_NEGATED)) {
+    printf("  - FAIL -a was computed incorrectly\n");
+    result &= 0;
+  }
+
+  ristretto_scalar_add(&c, &a, &b);
+  ristretto_scalar_to_bytes(bytes, &c);
+  if (!uint8_32_ct_eq(bytes, zero_bytes)) {
+    printf("  - FAIL a + (-a) was not zero\n");
+    result &= 0;
+  }
+
+  ristretto_scalar_sub(&c, &zero, &a);
+  ristretto_scalar_to_bytes(bytes, &c);
+  if (!uint8_32_ct_eq(bytes, A_BYTES_SCALAR_NEGATED)) {
+    printf("  - FAIL 0 - a did not match -a\n");
+    result &= 0;
+  }
+
+  ristretto_scalar_sub(&c, &a, &zero);
+  ristretto_scalar_sub(&c, &c, &a);
+  ristretto_scalar_to_bytes(bytes, &c);
+  if (!uint8_32_ct_eq(bytes, zero_bytes)) {
+    printf("  - FAIL (a - 0) - a was not zero\n");
+    result &= 0;
+  }
+
+  ristretto_scalar_invert(&b, &a);
+  ristretto_scalar_to_bytes(bytes, &b);
+  if (!uint8_32_ct_eq(bytes, A_BYTES_SCALAR_INVERSE)) {
+    printf("  - FAIL 1/a was computed incorrectly\n");
+    result &= 0;
+  }
+
+  ristretto_scalar_mul(&c, &a, &b);
+  ristretto_scalar_to_bytes(bytes, &c);
+  if (!uint8_32_ct_eq(bytes, one_bytes)) {
+    printf("  - FAIL a * (1/a) was not one\n");
+    result &= 0;
+  }
+
+  ristretto_scalar_invert(&c, &zero);
+  ristretto_scalar_to_bytes(bytes, &c);
+  if (!uint8_32_ct_eq(bytes, zero_bytes)) {
+    printf("  - FAIL 1/0 was not zero\n");
+    result &= 0;
+  }
+
+  memset(bytes, 0xff, 64);
+  ristretto_scalar_from_bytes_mod_order_wide(&c, bytes);
+  ristretto_scalar_to_bytes(bytes, &c);
+  if (!uint8_32_ct_eq(bytes, ALL_ONES_WIDE_SCALAR_REDUCED)) {
+    printf("  - FAIL wide reduction of 2^512 - 1 was incorrect\n");
+    result &= 0;
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_scalar_batch_invert()
+{
+  ristretto_scalar_t scalars[9], scratch[9], expected;
+  unsigned char bytes[32], expected_bytes[32];
+  uint8_t result = 1;
+  size_t i;
+
+  printf("test batch scalar inversion: ");
+
+  // Include zeros, which must not poison the rest of the batch
+  for (i=0; i<9; i++) {
+    fill_pseudorandom_bytes(bytes, 32, (uint32_t)i);
+    if (i == 0 || i == 5) {
+      memset(bytes, 0, 32);
+    }
+    ristretto_scalar_from_bytes_mod_order(&scalars[i], bytes);
+  }
+
+  ristretto_scalar_batch_invert(scalars, 9, scratch);
+
+  for (i=0; i<9; i++) {
+    fill_pseudorandom_bytes(bytes, 32, (uint32_t)i);
+    if (i == 0 || i == 5) {
+      memset(bytes, 0, 32);
+    }
+    ristretto_scalar_from_bytes_mod_order(&expected, bytes);
+    ristretto_scalar_invert(&expected, &expected);
+
+    ristretto_scalar_to_bytes(bytes, &scalars[i]);
+    ristretto_scalar_to_bytes(expected_bytes, &expected);
+
+    if (!uint8_32_ct_eq(bytes, expected_bytes)) {
+      printf("  - FAIL scalar #%zu was not inverted correctly\n", i);
+      result &= 0;
+    }
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ristretto_batch_normalize()
+{
+  ristretto_point_t points[7], P, Q;
+  ristretto_affine_point_t affine[7];
+  ristretto_scalar_t a, b, c;
+  unsigned char bytes[32];
+  uint8_t result = 1;
+  size_t i;
+
+  printf("test batch normalization to affine points: ");
+
+  // Results of scalar multiplication have arbitrary Z; include the identity
+  for (i=0; i<7; i++) {
+    fill_pseudorandom_bytes(bytes, 32, (uint32_t)(i + 1));
+    if (i == 3) {
+      memset(bytes, 0, 32);
+    }
+    ristretto_scalarmult_base(&points[i], bytes);
+  }
+
+  if (!ristretto_batch_normalize(affine, points, 7)) {
+    printf("  - FAIL could not allocate scratch space\n");
+    result &= 0;
+  }
+
+  for (i=0; i<7; i++) {
+    ristretto_affine_to_point(&P, &affine[i]);
+
+    if (ristretto_ct_eq(&P, &points[i]) != 1) {
+      printf("  - FAIL point #%zu changed when normalized\n", i);
+      result &= 0;
+    }
+  }
+
+  // [a]B + [b]B should be [a+b]B
+  fill_pseudorandom_bytes(bytes, 32, 1);
+  ristretto_scalar_from_bytes_mod_order(&a, bytes);
+  fill_pseudorandom_bytes(bytes, 32, 2);
+  ristretto_scalar_from_bytes_mod_order(&b, bytes);
+  ristretto_scalar_add(&c, &a, &b);
+  ristretto_scalar_to_bytes(bytes, &c);
+  ristretto_scalarmult_base(&Q, bytes);
+
+  ristretto_add_affine(&P, &points[0], &affine[1]);
+
+  if (ristretto_ct_eq(&P, &Q) != 1) {
+    printf("  - FAIL mixed addition was computed incorrectly\n");
+    result &= 0;
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
+int test_ed25519_sign_open()
+{
+  ed25519_secret_key sk[8];
+  ed25519_public_key pk[8];
+  ed25519_signature sig[8];
+  const unsigned char *messages[8], *pks[8], *sigs[8];
+  size_t lengths[8];
+  int valid[8];
+  uint8_t result = 1;
+  size_t i;
+
+  // In ED25519_RUNTIME_DISPATCH builds this goes through the backend picked
+  // at runtime, ED25519_BACKEND=<name> forces one of them
+  printf("test Ed25519 signing and verification on the %s backend: ", ed25519_backend());
+
+  for (i=0; i<8; i++) {
+    fill_pseudorandom_bytes(sk[i], 32, (uint32_t)(i + 100));
+    ed25519_publickey(sk[i], pk[i]);
+    ed25519_sign(sk[i], 32, sk[i], pk[i], sig[i]);
+    messages[i] = sk[i];
+    lengths[i] = 32;
+    pks[i] = pk[i];
+    sigs[i] = sig[i];
+
+    if (ed25519_sign_open(sk[i], 32, pk[i], sig[i]) != 0) {
+      printf("  - FAIL signature #%zu did not verify\n", i);
+      result &= 0;
+    }
+  }
+
+  if (ed25519_sign_open_batch(messages, lengths, pks, sigs, 8, valid) != 0) {
+    printf("  - FAIL valid batch did not verify\n");
+    result &= 0;
+  }
+
+  sig[3][0] ^= 1;
+  if (ed25519_sign_open(sk[3], 32, pk[3], sig[3]) == 0) {
+    printf("  - FAIL forged signature verified\n");
+    result &= 0;
+  }
+  if (ed25519_sign_open_batch(messages, lengths, pks, sigs, 8, valid) == 0) {
+    printf("  - FAIL batch with a forged signature verified\n");
+    result &= 0;
+  }
+  for (i=0; i<8; i++) {
+    if (valid[i] != (i != 3)) {
+      printf("  - FAIL signature #%zu was misreported in the batch\n", i);
+      result &= 0;
+    }
+  }
+
+  if (result != 1) {
+    printf("FAIL\n");
+  } else {
+    printf("OKAY\n");
+  }
+
+  return (int)result;
+}
+
 int main(int argc, char **argv)
 {
   int result;
 
   result  = test_invsqrt_random_field_element();
   result &= test_uint8_32_ct_eq();
+  result &= test_field_constants();
   result &= test_ristretto_decode_random_invalid_point();
   result &= test_ristretto_decode_basepoint();
   result &= test_curve25519_expand_random_field_element();
@@ -438,6 +1401,22 @@ int main(int argc, char **argv)
   result &= test_ristretto_encode_basepoint();
   result &= test_ristretto_encode_small_multiples_of_basepoint();
   result &= test_ristretto_ct_eq();
+  result &= test_ristretto_decode_batch();
+  result &= test_ristretto_encode_batch();
+  result &= test_ristretto_scalarmult_small_multiples_of_basepoint();
+  result &= test_ristretto_scalarmult_matches_basepoint_table();
+  result &= test_ristretto_scalarmult_base_small_multiples();
+  result &= test_ristretto_double_scalarmult_vartime();
+  result &= test_ristretto_multiscalar_mul_vartime();
+  result &= test_ristretto_double_and_encode_batch();
+  result &= test_ristretto_from_uniform_bytes();
+  result &= test_ristretto_from_uniform_bytes_batch();
+  result &= test_ristretto_basepoint_table();
+  result &= test_ristretto_basepoint_table_serialization();
+  result &= test_ristretto_scalar_arithmetic();
+  result &= test_ristretto_scalar_batch_invert();
+  result &= test_ristretto_batch_normalize();
+  result &= test_ed25519_sign_open();
 
   if (0 == result) {
     printf("SOME TESTS FAILED TO PASS\n");
@@ -208,6 +208,184 @@ test_batch(void) {
 	printf("%.0f ticks/verification\n", (double)sum / (count * test_batch_count));
 }
 
+/* large batches go through the pippenger path with heap or caller scratch */
+#define test_batch_large_count 300
+
+static void
+test_batch_large(void) {
+	static ed25519_secret_key sks[test_batch_large_count];
+	static ed25519_public_key pks[test_batch_large_count];
+	static ed25519_signature sigs[test_batch_large_count];
+	static unsigned char messages[test_batch_large_count][64];
+	static unsigned char bad_point[32];
+	size_t message_lengths[test_batch_large_count];
+	const unsigned char *message_pointers[test_batch_large_count];
+	const unsigned char *pk_pointers[test_batch_large_count];
+	const unsigned char *sig_pointers[test_batch_large_count];
+	int valid[test_batch_large_count], ret, expected, pass, kind;
+	size_t i, scratch_size;
+	void *scratch;
+	ed25519_batch *stream;
+
+	ed25519_randombytes_unsafe(sks, sizeof(sks));
+	ed25519_randombytes_unsafe(messages, sizeof(messages));
+	for (i = 0; i < test_batch_large_count; i++) {
+		ed25519_publickey(sks[i], pks[i]);
+		message_pointers[i] = messages[i];
+		message_lengths[i] = (i & 63) + 1;
+		ed25519_sign(message_pointers[i], message_lengths[i], sks[i], pks[i], sigs[i]);
+		pk_pointers[i] = pks[i];
+		sig_pointers[i] = sigs[i];
+	}
+
+	/* y = 2 has no x, so the public key fails to decode */
+	bad_point[0] = 2;
+
+	scratch_size = ed25519_sign_open_batch_scratch_size(test_batch_large_count);
+	edassert(scratch_size != 0, 0, "large batch needs no scratch");
+	scratch = malloc(scratch_size);
+
+	/*
+		0: valid, 1: wrong signature, 2: undecodable key, 3: several wrong signatures,
+		4: three wrong signatures far apart, 5: every fourth signature wrong,
+		each with heap scratch, caller scratch, on 3 threads and streamed
+	*/
+	for (pass = 0; pass < 24; pass++) {
+		kind = pass / 4;
+		if (kind == 1)
+			sig_pointers[257] = sigs[3];
+		else if (kind == 2)
+			pk_pointers[100] = bad_point;
+		else if (kind == 3)
+			for (i = 0; i < test_batch_large_count; i += 37)
+				sig_pointers[i] = sigs[i + 1];
+		else if (kind == 4)
+			for (i = 5; i < test_batch_large_count; i += 100)
+				sig_pointers[i] = sigs[i + 1];
+		else if (kind == 5)
+			for (i = 1; i < test_batch_large_count; i += 4)
+				sig_pointers[i] = sigs[i + 1];
+
+		if ((pass % 4) == 1) {
+			ret = ed25519_sign_open_batch_scratch(message_pointers, message_lengths, pk_pointers, sig_pointers, test_batch_large_count, valid, scratch, scratch_size);
+		} else if ((pass % 4) == 2) {
+			ret = ed25519_sign_open_batch_mt(message_pointers, message_lengths, pk_pointers, sig_pointers, test_batch_large_count, valid, 3);
+		} else if ((pass % 4) == 3) {
+			stream = ed25519_batch_init();
+			edassert(stream != NULL, pass, "failed to allocate a streaming batch");
+			for (i = 0; i < test_batch_large_count; i++)
+				edassert(!ed25519_batch_add(stream, message_pointers[i], message_lengths[i], pk_pointers[i], sig_pointers[i]), (int)i, "failed to add to a streaming batch");
+			ret = ed25519_batch_finalize(stream, valid);
+		} else {
+			ret = ed25519_sign_open_batch(message_pointers, message_lengths, pk_pointers, sig_pointers, test_batch_large_count, valid);
+		}
+
+		expected = (kind == 0) ? 0 : (kind == 2) ? 1 : (1|2);
+		edassert_equal((unsigned char *)&expected, (unsigned char *)&ret, sizeof(int), "large batch return code");
+		for (i = 0; i < test_batch_large_count; i++) {
+			expected = !(((kind == 1) && (i == 257)) || ((kind == 2) && (i == 100)) || ((kind == 3) && ((i % 37) == 0)) ||
+				((kind == 4) && ((i % 100) == 5)) || ((kind == 5) && ((i % 4) == 1)));
+			edassert_equal((unsigned char *)&expected, (unsigned char *)&valid[i], sizeof(int), "individual large batch return code");
+		}
+
+		for (i = 0; i < test_batch_large_count; i++)
+			sig_pointers[i] = sigs[i];
+		pk_pointers[100] = pks[100];
+	}
+
+	/* streams too short for a batch */
+	for (pass = 0; pass < 3; pass++) {
+		stream = ed25519_batch_init();
+		edassert(stream != NULL, pass, "failed to allocate a streaming batch");
+		for (i = 0; i < (size_t)pass; i++)
+			edassert(!ed25519_batch_add(stream, message_pointers[i], message_lengths[i], pk_pointers[i], (i == 1) ? sig_pointers[0] : sig_pointers[i]), (int)i, "failed to add to a streaming batch");
+		ret = ed25519_batch_finalize(stream, valid);
+		expected = (pass == 2) ? 1 : 0;
+		edassert_equal((unsigned char *)&expected, (unsigned char *)&ret, sizeof(int), "short stream return code");
+		if (pass)
+			edassert(valid[0] == 1, pass, "short stream rejected a valid signature");
+		if (pass == 2)
+			edassert(valid[1] == 0, pass, "short stream accepted a wrong signature");
+	}
+
+	free(scratch);
+}
+
+/* batches where a few keys sign most of the messages, as one combination and in chunks */
+#define test_batch_keys_count 300
+
+static void
+test_batch_shared_keys(void) {
+	static const size_t sizes[3] = {5, 64, test_batch_keys_count};
+	static ed25519_secret_key sks[8];
+	static ed25519_public_key pks[8];
+	static ed25519_signature sigs[test_batch_keys_count];
+	static unsigned char messages[test_batch_keys_count][32];
+	static unsigned char bad_point[32];
+	size_t message_lengths[test_batch_keys_count];
+	const unsigned char *message_pointers[test_batch_keys_count];
+	const unsigned char *pk_pointers[test_batch_keys_count];
+	const unsigned char *sig_pointers[test_batch_keys_count];
+	int valid[test_batch_keys_count], ret, expected, pass, bad;
+	size_t i, j, num, signer;
+	ed25519_batch *stream;
+
+	ed25519_randombytes_unsafe(sks, sizeof(sks));
+	ed25519_randombytes_unsafe(messages, sizeof(messages));
+	for (i = 0; i < 8; i++)
+		ed25519_publickey(sks[i], pks[i]);
+
+	/* key 0 signs every other message, the rest are spread over 7 keys */
+	for (i = 0; i < test_batch_keys_count; i++) {
+		signer = (i & 1) ? 0 : (1 + (i % 7));
+		message_pointers[i] = messages[i];
+		message_lengths[i] = 32;
+		ed25519_sign(message_pointers[i], message_lengths[i], sks[signer], pks[signer], sigs[i]);
+		pk_pointers[i] = pks[signer];
+	}
+
+	bad_point[0] = 2;
+
+	/* 0: valid, 1: a wrong signature under key 0, 2: an undecodable key shared by two signatures; with each entry point */
+	for (j = 0; j < 3; j++) {
+		num = sizes[j];
+		for (pass = 0; pass < 12; pass++) {
+			bad = pass / 4;
+			for (i = 0; i < num; i++)
+				sig_pointers[i] = sigs[i];
+			if (bad == 1)
+				sig_pointers[num - 2] = sigs[1];
+			if (bad == 2) {
+				pk_pointers[0] = bad_point;
+				pk_pointers[num - 1] = bad_point;
+			}
+
+			if ((pass % 4) == 1) {
+				ret = ed25519_sign_open_batch_scratch(message_pointers, message_lengths, pk_pointers, sig_pointers, num, valid, NULL, 0);
+			} else if ((pass % 4) == 2) {
+				ret = ed25519_sign_open_batch_mt(message_pointers, message_lengths, pk_pointers, sig_pointers, num, valid, 2);
+			} else if ((pass % 4) == 3) {
+				stream = ed25519_batch_init();
+				edassert(stream != NULL, pass, "failed to allocate a streaming batch");
+				for (i = 0; i < num; i++)
+					ed25519_batch_add(stream, message_pointers[i], message_lengths[i], pk_pointers[i], sig_pointers[i]);
+				ret = ed25519_batch_finalize(stream, valid);
+			} else {
+				ret = ed25519_sign_open_batch(message_pointers, message_lengths, pk_pointers, sig_pointers, num, valid);
+			}
+
+			for (i = 0; i < num; i++) {
+				expected = !(((bad == 1) && (i == (num - 2))) || ((bad == 2) && ((i == 0) || (i == (num - 1)))));
+				edassert_equal((unsigned char *)&expected, (unsigned char *)&valid[i], sizeof(int), "individual shared key batch return code");
+			}
+			edassert((ret != 0) == (bad != 0), pass, "shared key batch return code");
+
+			pk_pointers[0] = pks[1];
+			pk_pointers[num - 1] = pks[((num - 1) & 1) ? 0 : (1 + ((num - 1) % 7))];
+		}
+	}
+}
+
 static void
 test_main(void) {
 	int i, res;
@@ -251,10 +429,79 @@ test_main(void) {
 	printf("%.0f ticks/curve25519 basepoint scalarmult\n", (double)curvedticks);
 }
 
+static void
+test_sign_batch(void) {
+	const unsigned char *sks[100], *ms[100], *pkps[100];
+	unsigned char *pkouts[100], *sigouts[100];
+	ed25519_public_key pks[100];
+	ed25519_signature sigs[100];
+	size_t mlens[100];
+	uint64_t ticks, pkticks = maxticks, pkbatchticks = maxticks, signticks = maxticks, signbatchticks = maxticks;
+	int i, j;
+
+	/* more than one batch, and an uneven last batch */
+	for (i = 0; i < 100; i++) {
+		sks[i] = dataset[i].sk;
+		ms[i] = (const unsigned char *)dataset[i].m;
+		mlens[i] = i;
+		pkps[i] = pks[i];
+		pkouts[i] = pks[i];
+		sigouts[i] = sigs[i];
+	}
+
+	ed25519_publickey_batch(sks, pkouts, 100);
+	for (i = 0; i < 100; i++)
+		edassert_equal_round(dataset[i].pk, pks[i], sizeof(ed25519_public_key), i, "batch public key didn't match");
+
+	ed25519_sign_batch(ms, mlens, sks, pkps, sigouts, 100);
+	for (i = 0; i < 100; i++)
+		edassert_equal_round(dataset[i].sig, sigs[i], sizeof(ed25519_signature), i, "batch signature didn't match");
+
+	for (j = 0; j < 32; j++) {
+		timeit(for (i = 0; i < 100; i++) ed25519_publickey(sks[i], pkouts[i]), pkticks)
+		timeit(ed25519_publickey_batch(sks, pkouts, 100), pkbatchticks)
+		timeit(for (i = 0; i < 100; i++) ed25519_sign(ms[i], mlens[i], sks[i], pkps[i], sigouts[i]), signticks)
+		timeit(ed25519_sign_batch(ms, mlens, sks, pkps, sigouts, 100), signbatchticks)
+	}
+
+	printf("%.0f ticks/public key generation, %.0f batched\n", (double)pkticks / 100, (double)pkbatchticks / 100);
+	printf("%.0f ticks/signature, %.0f batched\n", (double)signticks / 100, (double)signbatchticks / 100);
+}
+
+static void
+test_curved25519_batch(void) {
+	curved25519_key sk[100], pk[100], batchpk[100];
+	uint64_t ticks, singleticks = maxticks, batchticks = maxticks;
+	int i, j;
+
+	/* more than one batch, and an uneven last batch */
+	for (i = 0; i < 100; i++)
+		memcpy(sk[i], dataset[i].sk, sizeof(curved25519_key));
+	sk[99][0] = 0;
+
+	curved25519_scalarmult_basepoint_batch(batchpk, (const curved25519_key *)sk, 100);
+	for (i = 0; i < 100; i++) {
+		curved25519_scalarmult_basepoint(pk[i], sk[i]);
+		edassert_equal_round(pk[i], batchpk[i], sizeof(curved25519_key), i, "batch curve25519 did not match");
+	}
+
+	for (j = 0; j < 32; j++) {
+		timeit(for (i = 0; i < 100; i++) curved25519_scalarmult_basepoint(pk[i], sk[i]), singleticks)
+		timeit(curved25519_scalarmult_basepoint_batch(batchpk, (const curved25519_key *)sk, 100), batchticks)
+	}
+
+	printf("%.0f ticks/curve25519 basepoint scalarmult, %.0f batched\n", (double)singleticks / 100, (double)batchticks / 100);
+}
+
 int
 main(void) {
+	printf("backend: %s\n", ed25519_backend());
 	test_main();
+	test_sign_batch();
+	test_curved25519_batch();
 	test_batch();
+	test_batch_large();
+	test_batch_shared_keys();
 	return 0;
 }
 